@@ -58,10 +58,87 @@ typedef struct {
     GLASSGPUCommandList GPUCmdList; ///< GPU command list (default: all NULL).
     bool vsync;                     ///< Enable VSync (default: true).
     bool horizontalFlip;            ///< Flip display buffer horizontally (default: false).
-    bool flushAllLinearMem;         ///< Whether to flush all linear memory (default: true).
+    bool flushAllLinearMem;         ///< Whether to flush all linear memory, instead of written ranges only (default: false).
     GLASSDownscale downscale;       ///< Set downscale for anti-aliasing (default: GLASS_DOWNSCALE_NONE).
+    size_t scratchSize;             ///< Size of the linear arena for temporary buffers, 0 to disable (default: 256KiB).
+    size_t textureVRAMBudget;       ///< VRAM the residency manager can fill with textures, 0 to disable (default: 0).
 } GLASSCtxParams;
 
+/// @brief Frame statistics.
+typedef struct {
+    size_t numSubmits;      ///< Num of command lists sent to the GPU.
+    size_t numFlushRegions; ///< Num of memory regions flushed from the data cache on submit.
+    size_t flushedBytes;    ///< Bytes flushed from the data cache on submit.
+} GLASSFrameStats;
+
+/// @brief Statistics of the linear sub-allocator.
+typedef struct {
+    size_t numSlabs;         ///< Num of linear blocks reserved for small allocations.
+    size_t numEmptySlabs;    ///< Num of slabs with no chunk in use.
+    size_t reservedBytes;    ///< Bytes reserved by slabs.
+    size_t usedBytes;        ///< Bytes of chunks in use, the rest of the reserved bytes is fragmentation.
+    size_t largestFreeChunk; ///< Largest chunk available without reserving a new slab.
+} GLASSSubAllocStats;
+
+/// @brief Num of memory kinds.
+#define GLASS_NUM_MEMORY_KINDS 3
+
+/// @brief Num of memory categories.
+#define GLASS_NUM_MEMORY_CATEGORIES 6
+
+/// @brief Num of native texture formats.
+#define GLASS_NUM_TEXTURE_FORMATS 14
+
+/// @brief Kind of memory.
+typedef enum {
+    GLASS_MEMORY_HEAP,   ///< Heap memory.
+    GLASS_MEMORY_LINEAR, ///< Linear memory.
+    GLASS_MEMORY_VRAM,   ///< VRAM.
+} GLASSMemoryKind;
+
+/// @brief What memory is used for.
+typedef enum {
+    GLASS_MEMORY_BUFFERS,       ///< Buffer object storage.
+    GLASS_MEMORY_TEXTURES,      ///< Texture object storage.
+    GLASS_MEMORY_RENDERBUFFERS, ///< Renderbuffer storage and transient render targets.
+    GLASS_MEMORY_SHADERS,       ///< Shader binaries.
+    GLASS_MEMORY_COMMAND_LISTS, ///< GPU command lists.
+    GLASS_MEMORY_SCRATCH,       ///< Temporary buffers.
+} GLASSMemoryCategory;
+
+/// @brief Memory usage.
+typedef struct {
+    size_t current; ///< Bytes in use.
+    size_t peak;    ///< Max bytes in use at once.
+    size_t count;   ///< Num of allocations in use.
+} GLASSMemoryUsage;
+
+/// @brief Memory statistics.
+typedef struct {
+    GLASSMemoryUsage kinds[GLASS_NUM_MEMORY_KINDS];                                   ///< Usage by kind.
+    GLASSMemoryUsage categories[GLASS_NUM_MEMORY_CATEGORIES][GLASS_NUM_MEMORY_KINDS]; ///< Usage by category and kind.
+    GLASSMemoryUsage textureFormats[GLASS_NUM_TEXTURE_FORMATS];                       ///< Texture usage by native format (0 = RGBA8, 13 = ETC1A4).
+    size_t largestFreeBlock[GLASS_NUM_MEMORY_KINDS];                                  ///< Largest block that can be allocated, by kind.
+} GLASSMemoryStats;
+
+/// @brief Memory allocated for an object (debug mode only).
+typedef struct {
+    const void* address;          ///< Allocation address.
+    size_t size;                  ///< Allocation size.
+    GLASSMemoryKind kind;         ///< Memory kind.
+    GLASSMemoryCategory category; ///< Memory category.
+    GLuint owner;                 ///< Owning object, 0 if none.
+} GLASSMemoryAllocation;
+
+/// @brief Kind of object purged to stay within memory budgets.
+typedef enum {
+    GLASS_PURGED_TEXTURE, ///< Texture object.
+    GLASS_PURGED_BUFFER,  ///< Buffer object.
+} GLASSPurgedType;
+
+/// @brief Called after the storage of a purgeable object has been freed.
+typedef void (*GLASSPurgeCallback)(GLASSPurgedType type, GLuint name, void* userData);
+
 /// @brief Fog LUT.
 typedef struct {
     GLfloat values[GLASS_NUM_FOG_LUT_VALUES];
@@ -84,8 +161,10 @@ KYGX_INLINE void glassGetDefaultContextParams(GLASSCtxParams* ctxParams, GLASSVe
     ctxParams->GPUCmdList.offset = 0;
     ctxParams->vsync = true;
     ctxParams->horizontalFlip = false;
-    ctxParams->flushAllLinearMem = true;
+    ctxParams->flushAllLinearMem = false;
     ctxParams->downscale = GLASS_DOWNSCALE_NONE;
+    ctxParams->scratchSize = 0x40000;
+    ctxParams->textureVRAMBudget = 0;
 }
 
 // Create context.
@@ -164,6 +243,36 @@ bool glassFlushesAllLinearMem(GLASSCtx ctx);
 // Set flush all linear mem.
 void glassSetFlushAllLinearMem(GLASSCtx ctx, bool enabled);
 
+// Get VRAM budget for automatic texture residency.
+size_t glassGetTextureVRAMBudget(GLASSCtx ctx);
+
+// Set VRAM budget for automatic texture residency, 0 to disable.
+void glassSetTextureVRAMBudget(GLASSCtx ctx, size_t budget);
+
+// Get stats of the last frame swapped by the context.
+void glassGetFrameStats(GLASSCtx ctx, GLASSFrameStats* stats);
+
+// Get stats of the linear sub-allocator used for small buffers.
+void glassGetSubAllocStats(GLASSSubAllocStats* stats);
+
+// Get bytes allocated by GLASS in a VRAM bank.
+size_t glassGetVRAMBankUsage(KYGXVRAMBank bank);
+
+// Get memory statistics. Free blocks are found by probing the allocators, avoid calling this every frame.
+void glassGetMemoryStats(GLASSMemoryStats* stats);
+
+// Get memory allocations in use, up to max. Returns the total num of allocations, always 0 in release mode.
+size_t glassGetMemoryAllocations(GLASSMemoryAllocation* allocations, size_t max);
+
+// Set limits for linear memory and VRAM used by object storage, 0 for no limit.
+void glassSetMemoryBudget(size_t linear, size_t vram);
+
+// Set the function called when purgeable objects are purged, NULL to disable.
+void glassSetPurgeCallback(GLASSPurgeCallback callback, void* userData);
+
+// Relocate VRAM textures and renderbuffers to reduce fragmentation. UB if no bound context.
+void glassCompactVRAM(void);
+
 // Get downscale.
 GLASSDownscale glassGetDownscale(GLASSCtx ctx);
 
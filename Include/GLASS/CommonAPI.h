@@ -17,6 +17,17 @@ void glGenBuffers(GLsizei n, GLuint* buffers);
 void glGetBufferParameteriv(GLenum target, GLenum pname, GLint* params);
 GLboolean glIsBuffer(GLuint buffer);
 
+/* Buffers (extensions) */
+
+void glBufferPurgeablePICA(GLenum target, GLboolean purgeable);
+void glBufferStorageExternalPICA(GLenum target, GLvoid* data, GLsizeiptr size, GLBUFFERRELEASEPROCPICA release);
+void glBufferVRAMPICA(GLenum target, GLboolean enabled);
+void glFlushMappedBufferRangeEXT(GLenum target, GLintptr offset, GLsizeiptr length);
+void glGetBufferPointervOES(GLenum target, GLenum pname, GLvoid** params);
+void* glMapBufferOES(GLenum target, GLenum access);
+void* glMapBufferRangeEXT(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+GLboolean glUnmapBufferOES(GLenum target);
+
 /* Combiners (extensions) */
 
 void glCombinerBufferColorPICA(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha);
@@ -107,6 +118,9 @@ void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, G
 
 /* Texture (extensions) */
 
+void glTexPurgeablePICA(GLboolean purgeable);
+void glTexTransientPICA(GLboolean transient);
+void glTexVRAMBankPICA(GLenum bank);
 void glTexVRAMPICA(GLboolean enabled);
 
 #if defined(__cplusplus)
@@ -19,12 +19,22 @@ typedef GLuint GLenum;
 typedef GLfloat GLclampf;
 typedef GLuint GLbitfield;
 
+typedef void (*GLBUFFERRELEASEPROCPICA)(GLvoid* data, GLsizeiptr size);
+
 #define GL_DEPTH_BUFFER_BIT 0x00000100
 #define GL_STENCIL_BUFFER_BIT 0x00000400
 #define GL_COLOR_BUFFER_BIT 0x00004000
 #define GL_EARLY_DEPTH_BUFFER_BIT_PICA 0x80000000
 
+#define GL_MAP_READ_BIT_EXT 0x0001
+#define GL_MAP_WRITE_BIT_EXT 0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT_EXT 0x0004
+#define GL_MAP_INVALIDATE_BUFFER_BIT_EXT 0x0008
+#define GL_MAP_FLUSH_EXPLICIT_BIT_EXT 0x0010
+#define GL_MAP_UNSYNCHRONIZED_BIT_EXT 0x0020
+
 #define GL_NO_ERROR 0
+#define GL_NONE 0
 
 #define GL_FALSE 0
 #define GL_TRUE 1
@@ -197,6 +207,7 @@ typedef GLuint GLbitfield;
 #define GL_ONE_MINUS_SRC_G_PICA 0x6408
 #define GL_ONE_MINUS_SRC_B_PICA 0x6409
 #define GL_HILO8_PICA 0x6700
+#define GL_COMPACT_FORMAT_PICA 0x6701
 #define GL_ETC1_ALPHA_RGB8_A4_PICA 0x675B
 #define GL_UNSIGNED_BYTE_4_4_PICA 0x6760
 #define GL_UNSIGNED_NIBBLE_PICA 0x6761
@@ -206,6 +217,9 @@ typedef GLuint GLbitfield;
 #define GL_DEPTH_STENCIL_COPY_PICA 0x67A0
 #define GL_FRAMEBUFFER_BINDING_PICA 0x6CA6
 #define GL_SCISSOR_TEST_INVERTED_PICA 0x6E00
+#define GL_VRAM_BANK_A_PICA 0x6F00
+#define GL_VRAM_BANK_B_PICA 0x6F01
+#define GL_VRAM_BANK_PICA 0x6F02
 
 #define GL_CONSTANT_COLOR 0x8001
 #define GL_ONE_MINUS_CONSTANT_COLOR 0x8002
@@ -314,9 +328,15 @@ typedef GLuint GLbitfield;
 #define GL_ARRAY_BUFFER_BINDING 0x8894
 #define GL_ELEMENT_ARRAY_BUFFER_BINDING 0x8895
 #define GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING 0x889F
+#define GL_WRITE_ONLY_OES 0x88B9
+#define GL_BUFFER_ACCESS_OES 0x88BB
+#define GL_BUFFER_MAPPED_OES 0x88BC
+#define GL_BUFFER_MAP_POINTER_OES 0x88BD
 #define GL_STREAM_DRAW 0x88E0
 #define GL_STATIC_DRAW 0x88E4
 #define GL_DYNAMIC_DRAW 0x88E8
+#define GL_PIXEL_PACK_BUFFER_NV 0x88EB
+#define GL_PIXEL_PACK_BUFFER_BINDING_NV 0x88ED
 #define GL_DEPTH24_STENCIL8_OES 0x88F0
 
 #define GL_VERTEX_SHADER 0x8B31
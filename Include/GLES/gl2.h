@@ -46,6 +46,13 @@ GLboolean glIsFramebuffer(GLuint framebuffer);
 GLboolean glIsRenderbuffer(GLuint renderbuffer);
 void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
 
+/* Framebuffer (extensions) */
+
+void glDiscardFramebufferEXT(GLenum target, GLsizei numAttachments, const GLenum* attachments);
+void glReleaseTransientStoragePICA(GLuint name);
+void glRenderbufferTransientPICA(GLenum target, GLboolean transient);
+void glRenderbufferVRAMBankPICA(GLenum target, GLenum bank);
+
 /* Shaders */
 
 void glAttachShader(GLuint program, GLuint shader);
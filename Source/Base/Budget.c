@@ -0,0 +1,225 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Base/Budget.h"
+#include "Base/BufferPool.h"
+#include "Base/MemStats.h"
+#include "Base/Read.h"
+#include "Base/TexManager.h"
+#include "Base/VRAM.h"
+
+#include <string.h> // memcpy
+
+static size_t g_LinearUsage = 0;
+static size_t g_LinearBudget = 0;
+static size_t g_VRAMBudget = 0;
+
+static GLASSPurgeCallback g_Callback = NULL;
+static void* g_CallbackData = NULL;
+
+// Objects that can be purged.
+static GLuint* g_Purgeable = NULL;
+static size_t g_NumPurgeable = 0;
+static size_t g_PurgeableCapacity = 0;
+
+void GLASS_budget_setLimits(size_t linear, size_t vram) {
+    g_LinearBudget = linear;
+    g_VRAMBudget = vram;
+}
+
+void GLASS_budget_setCallback(GLASSPurgeCallback callback, void* userData) {
+    g_Callback = callback;
+    g_CallbackData = userData;
+}
+
+void GLASS_budget_addLinearUsage(size_t size) { g_LinearUsage += size; }
+
+void GLASS_budget_removeLinearUsage(size_t size) {
+    KYGX_ASSERT(g_LinearUsage >= size);
+    g_LinearUsage -= size;
+}
+
+size_t GLASS_budget_getLinearUsage(void) { return g_LinearUsage; }
+
+static bool addPurgeable(GLuint obj) {
+    for (size_t i = 0; i < g_NumPurgeable; ++i) {
+        if (g_Purgeable[i] == obj)
+            return true;
+    }
+
+    if (g_NumPurgeable == g_PurgeableCapacity) {
+        const size_t newCapacity = g_PurgeableCapacity ? (g_PurgeableCapacity << 1) : 32;
+        GLuint* purgeable = (GLuint*)glassHeapAlloc(newCapacity * sizeof(GLuint));
+        if (!purgeable)
+            return false;
+
+        if (g_Purgeable) {
+            memcpy(purgeable, g_Purgeable, g_NumPurgeable * sizeof(GLuint));
+            glassHeapFree(g_Purgeable);
+        }
+
+        g_Purgeable = purgeable;
+        g_PurgeableCapacity = newCapacity;
+    }
+
+    g_Purgeable[g_NumPurgeable++] = obj;
+    return true;
+}
+
+static void removePurgeable(GLuint obj) {
+    for (size_t i = 0; i < g_NumPurgeable; ++i) {
+        if (g_Purgeable[i] == obj) {
+            g_Purgeable[i] = g_Purgeable[--g_NumPurgeable];
+            return;
+        }
+    }
+}
+
+bool GLASS_budget_setPurgeable(GLuint obj, bool purgeable) {
+    const bool tracked = purgeable && addPurgeable(obj);
+
+    if (GLASS_OBJ_IS_TEXTURE(obj)) {
+        ((TextureInfo*)obj)->purgeable = tracked;
+    } else {
+        KYGX_ASSERT(GLASS_OBJ_IS_BUFFER(obj));
+        ((BufferInfo*)obj)->purgeable = tracked;
+    }
+
+    if (!purgeable)
+        removePurgeable(obj);
+
+    return tracked == purgeable;
+}
+
+static inline size_t getUsage(bool vram) {
+    return vram ? (GLASS_vram_getUsage(KYGX_ALLOC_VRAM_BANK_A) + GLASS_vram_getUsage(KYGX_ALLOC_VRAM_BANK_B)) : g_LinearUsage;
+}
+
+// Size of the storage that would be freed by purging the object, 0 if not purgeable.
+static size_t getPurgeableSize(GLuint obj, bool vram, u32* fence) {
+    if (GLASS_OBJ_IS_TEXTURE(obj)) {
+        const TextureInfo* tex = (TextureInfo*)obj;
+        if (!tex->faces[0] || (tex->vram != vram) || tex->transient)
+            return 0;
+
+        *fence = tex->fence;
+        return GLASS_tex_getDataSize(tex);
+    }
+
+    const BufferInfo* info = (BufferInfo*)obj;
+    if (!info->address || info->release || info->mapAccess || (glassIsVRAM(info->address) != vram))
+        return 0;
+
+    *fence = info->fence;
+    return vram ? glassVRAMSize(info->address) : GLASS_bufferPool_getCapacity(info->size);
+}
+
+static void purgeBuffer(CtxCommon* ctx, BufferInfo* info) {
+    GLASS_read_discardPack(info);
+
+    if (glassIsVRAM(info->address)) {
+        GLASS_memStats_remove(GLASS_MEMORY_BUFFERS, info->address, glassVRAMSize(info->address));
+        GLASS_vram_free(info->address);
+    } else {
+        GLASS_memStats_remove(GLASS_MEMORY_BUFFERS, info->address, GLASS_bufferPool_getCapacity(info->size));
+        GLASS_bufferPool_release(ctx, info->address, info->size, info->fence);
+    }
+
+    info->address = NULL;
+    info->size = 0;
+
+    for (size_t i = 0; i < GLASS_NUM_ATTRIB_REGS; ++i) {
+        AttributeInfo* attrib = &ctx->attribs[i];
+
+        if (!(attrib->flags & GLASS_ATTRIB_FLAG_FIXED) && (attrib->boundBuffer == (GLuint)info)) {
+            attrib->physAddr = 0;
+            ctx->flags |= GLASS_CONTEXT_FLAG_ATTRIBS;
+        }
+    }
+}
+
+// Purge the least recently used object, returns its size.
+static size_t purgeLRU(CtxCommon* ctx, bool vram, GLuint exclude) {
+    GLuint victim = GLASS_INVALID_OBJECT;
+    size_t victimSize = 0;
+    u32 victimFence = 0;
+
+    for (size_t i = 0; i < g_NumPurgeable; ++i) {
+        const GLuint obj = g_Purgeable[i];
+        if (obj == exclude)
+            continue;
+
+        u32 fence = 0;
+        const size_t size = getPurgeableSize(obj, vram, &fence);
+
+        if (size && ((victim == GLASS_INVALID_OBJECT) || ((s32)(fence - victimFence) < 0))) {
+            victim = obj;
+            victimSize = size;
+            victimFence = fence;
+        }
+    }
+
+    if (victim == GLASS_INVALID_OBJECT)
+        return 0;
+
+    if (GLASS_OBJ_IS_TEXTURE(victim)) {
+        GLASS_tex_freeData((TextureInfo*)victim);
+        ctx->flags |= (GLASS_CONTEXT_FLAG_TEXTURE | GLASS_CONTEXT_FLAG_FRAMEBUFFER);
+    } else {
+        purgeBuffer(ctx, (BufferInfo*)victim);
+    }
+
+    if (g_Callback)
+        g_Callback(GLASS_OBJ_IS_TEXTURE(victim) ? GLASS_PURGED_TEXTURE : GLASS_PURGED_BUFFER, GLASS_getObjectName(victim), g_CallbackData);
+
+    return victimSize;
+}
+
+static void waitIdle(CtxCommon* ctx, bool* idle) {
+    if (!*idle) {
+        GLASS_context_flush(ctx, true);
+        kygxWaitCompletion();
+        *idle = true;
+    }
+}
+
+bool GLASS_budget_reserve(CtxCommon* ctx, bool vram, size_t size, GLuint exclude) {
+    KYGX_ASSERT(ctx);
+
+    const size_t budget = vram ? g_VRAMBudget : g_LinearBudget;
+    if (!budget)
+        return true;
+
+    bool idle = false;
+    while ((getUsage(vram) + size) > budget) {
+        // Storage is freed right away, the GPU must be done with it.
+        waitIdle(ctx, &idle);
+
+        if (!purgeLRU(ctx, vram, exclude))
+            return false;
+    }
+
+    return true;
+}
+
+bool GLASS_budget_purge(CtxCommon* ctx, bool vram, size_t size, GLuint exclude) {
+    KYGX_ASSERT(ctx);
+
+    bool idle = false;
+    size_t purged = 0;
+
+    while (purged < size) {
+        waitIdle(ctx, &idle);
+
+        const size_t purgedSize = purgeLRU(ctx, vram, exclude);
+        if (!purgedSize)
+            break;
+
+        purged += purgedSize;
+    }
+
+    return purged > 0;
+}
@@ -0,0 +1,24 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_BUDGET_H
+#define _GLASS_BASE_BUDGET_H
+
+#include "Base/Context.h"
+
+void GLASS_budget_setLimits(size_t linear, size_t vram);
+void GLASS_budget_setCallback(GLASSPurgeCallback callback, void* userData);
+
+void GLASS_budget_addLinearUsage(size_t size);
+void GLASS_budget_removeLinearUsage(size_t size);
+size_t GLASS_budget_getLinearUsage(void);
+
+bool GLASS_budget_setPurgeable(GLuint obj, bool purgeable);
+
+bool GLASS_budget_reserve(CtxCommon* ctx, bool vram, size_t size, GLuint exclude);
+bool GLASS_budget_purge(CtxCommon* ctx, bool vram, size_t size, GLuint exclude);
+
+#endif /* _GLASS_BASE_BUDGET_H */
@@ -0,0 +1,229 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Buffer storage is recycled through power-of-two size classes.
+ * Blocks that are released while the GPU might still be reading
+ * them are tagged with the fence of the last draw that used them,
+ * and are only handed out again once that fence has completed.
+ *
+ * Blocks larger than the biggest class, or released when their
+ * class is full, are freed as soon as their fence completes.
+ * Application owned blocks are never cached, their release
+ * callback is invoked instead of freeing them.
+ *
+ * Small blocks are carved out of shared slabs by the sub-allocator.
+ */
+#include "Base/Budget.h"
+#include "Base/BufferPool.h"
+#include "Base/SubAlloc.h"
+
+#include <string.h> // memset
+
+#define MIN_CLASS_SIZE (1u << GLASS_MIN_BUFFER_POOL_CLASS_SHIFT)
+#define MAX_CLASS_SIZE (1u << (GLASS_MIN_BUFFER_POOL_CLASS_SHIFT + GLASS_NUM_BUFFER_POOL_CLASSES - 1))
+
+static inline size_t getClass(size_t size) {
+    size_t index = 0;
+
+    while ((MIN_CLASS_SIZE << index) < size)
+        ++index;
+
+    return index;
+}
+
+static BufferPoolEntry* allocEntry(BufferPool* pool) {
+    KYGX_ASSERT(pool);
+
+    BufferPoolEntry* entry = pool->freeEntries;
+    if (entry) {
+        pool->freeEntries = entry->next;
+        return entry;
+    }
+
+    return (BufferPoolEntry*)glassHeapAlloc(sizeof(BufferPoolEntry));
+}
+
+static inline void freeEntry(BufferPool* pool, BufferPoolEntry* entry) {
+    KYGX_ASSERT(pool);
+    KYGX_ASSERT(entry);
+
+    entry->next = pool->freeEntries;
+    pool->freeEntries = entry;
+}
+
+static void freeBlock(BufferPoolEntry* entry) {
+    KYGX_ASSERT(entry);
+
+    if (entry->release) {
+        entry->release(entry->address, entry->capacity);
+    } else {
+        GLASS_subAlloc_free(entry->address, entry->capacity);
+    }
+}
+
+void GLASS_bufferPool_collect(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+
+    BufferPool* pool = &ctx->bufferPool;
+    BufferPoolEntry** link = &pool->deferred;
+
+    while (*link) {
+        BufferPoolEntry* entry = *link;
+
+        if (GLASS_context_isFenceDone(ctx, entry->fence)) {
+            *link = entry->next;
+            freeBlock(entry);
+            freeEntry(pool, entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+}
+
+static void freeList(BufferPoolEntry* entry, bool freeData) {
+    while (entry) {
+        BufferPoolEntry* next = entry->next;
+
+        if (freeData)
+            freeBlock(entry);
+
+        glassHeapFree(entry);
+        entry = next;
+    }
+}
+
+void GLASS_bufferPool_init(BufferPool* pool) {
+    KYGX_ASSERT(pool);
+    memset(pool, 0, sizeof(BufferPool));
+}
+
+void GLASS_bufferPool_destroy(BufferPool* pool) {
+    KYGX_ASSERT(pool);
+
+    for (size_t i = 0; i < GLASS_NUM_BUFFER_POOL_CLASSES; ++i)
+        freeList(pool->classes[i], true);
+
+    freeList(pool->deferred, true);
+    freeList(pool->freeEntries, false);
+    memset(pool, 0, sizeof(BufferPool));
+}
+
+size_t GLASS_bufferPool_getCapacity(size_t size) {
+    if (size > MAX_CLASS_SIZE)
+        return size;
+
+    return MIN_CLASS_SIZE << getClass(size);
+}
+
+static u8* acquireImpl(CtxCommon* ctx, size_t size) {
+    BufferPool* pool = &ctx->bufferPool;
+    GLASS_bufferPool_collect(ctx);
+
+    if (size > MAX_CLASS_SIZE)
+        return GLASS_subAlloc_alloc(size);
+
+    // Look for a block the GPU is done with.
+    const size_t index = getClass(size);
+    BufferPoolEntry** link = &pool->classes[index];
+
+    while (*link) {
+        BufferPoolEntry* entry = *link;
+
+        if (GLASS_context_isFenceDone(ctx, entry->fence)) {
+            u8* address = entry->address;
+            KYGX_ASSERT(!entry->release);
+            *link = entry->next;
+            --pool->numCached[index];
+            freeEntry(pool, entry);
+            return address;
+        }
+
+        link = &entry->next;
+    }
+
+    return GLASS_subAlloc_alloc(MIN_CLASS_SIZE << index);
+}
+
+u8* GLASS_bufferPool_acquire(CtxCommon* ctx, size_t size) {
+    KYGX_ASSERT(ctx);
+
+    u8* address = acquireImpl(ctx, size);
+    if (address)
+        GLASS_budget_addLinearUsage(GLASS_bufferPool_getCapacity(size));
+
+    return address;
+}
+
+void GLASS_bufferPool_release(CtxCommon* ctx, u8* address, size_t size, u32 fence) {
+    KYGX_ASSERT(ctx);
+
+    if (!address)
+        return;
+
+    const size_t capacity = GLASS_bufferPool_getCapacity(size);
+    GLASS_budget_removeLinearUsage(capacity);
+
+    BufferPool* pool = &ctx->bufferPool;
+    const bool done = GLASS_context_isFenceDone(ctx, fence);
+    const size_t index = (size <= MAX_CLASS_SIZE) ? getClass(size) : GLASS_NUM_BUFFER_POOL_CLASSES;
+    const bool cacheable = (index < GLASS_NUM_BUFFER_POOL_CLASSES) && (pool->numCached[index] < GLASS_MAX_BUFFER_POOL_CACHED);
+
+    // Blocks that can't be recycled are freed right away if unused.
+    if (!cacheable && done) {
+        GLASS_subAlloc_free(address, capacity);
+        return;
+    }
+
+    BufferPoolEntry* entry = allocEntry(pool);
+    if (!entry) {
+        // Last resort: wait for the GPU.
+        GLASS_context_waitFence(ctx, fence);
+        GLASS_subAlloc_free(address, capacity);
+        return;
+    }
+
+    entry->address = address;
+    entry->capacity = capacity;
+    entry->fence = fence;
+    entry->release = NULL;
+
+    if (cacheable) {
+        entry->next = pool->classes[index];
+        pool->classes[index] = entry;
+        ++pool->numCached[index];
+    } else {
+        entry->next = pool->deferred;
+        pool->deferred = entry;
+    }
+}
+
+void GLASS_bufferPool_releaseExternal(CtxCommon* ctx, u8* address, size_t size, u32 fence, GLBUFFERRELEASEPROCPICA release) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(address);
+
+    if (!release)
+        return;
+
+    BufferPool* pool = &ctx->bufferPool;
+    if (!GLASS_context_isFenceDone(ctx, fence)) {
+        BufferPoolEntry* entry = allocEntry(pool);
+        if (entry) {
+            entry->address = address;
+            entry->capacity = size;
+            entry->fence = fence;
+            entry->release = release;
+            entry->next = pool->deferred;
+            pool->deferred = entry;
+            return;
+        }
+
+        // Last resort: wait for the GPU.
+        GLASS_context_waitFence(ctx, fence);
+    }
+
+    release(address, size);
+}
@@ -0,0 +1,22 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_BUFFERPOOL_H
+#define _GLASS_BASE_BUFFERPOOL_H
+
+#include "Base/Context.h"
+
+void GLASS_bufferPool_init(BufferPool* pool);
+void GLASS_bufferPool_destroy(BufferPool* pool);
+
+size_t GLASS_bufferPool_getCapacity(size_t size);
+
+u8* GLASS_bufferPool_acquire(CtxCommon* ctx, size_t size);
+void GLASS_bufferPool_release(CtxCommon* ctx, u8* address, size_t size, u32 fence);
+void GLASS_bufferPool_releaseExternal(CtxCommon* ctx, u8* address, size_t size, u32 fence, GLBUFFERRELEASEPROCPICA release);
+void GLASS_bufferPool_collect(CtxCommon* ctx);
+
+#endif /* _GLASS_BASE_BUFFERPOOL_H */
@@ -11,13 +11,19 @@
 #include <mem_map.h> // FCRAM_BASE, FCRAM_SIZE, FCRAM_EXT_SIZE
 #endif // KYGX_BAREMETAL
 
+#include "Base/BufferPool.h"
 #include "Base/Context.h"
+#include "Base/Math.h"
+#include "Base/Scratch.h"
 #include "Base/TexManager.h"
+#include "Base/Transient.h"
 #include "Platform/GPU.h"
 #include "Platform/GFX.h"
 
 #include <string.h> // memset
 
+#define CACHE_LINE_SIZE 32
+
 static CtxCommon* g_Context = NULL;
 static CtxCommon* g_OldCtx = NULL;
 
@@ -31,10 +37,25 @@ void GLASS_context_initCommon(CtxCommon* ctx, const GLASSCtxParams* ctxParams) {
 
     // Platform.
     GLASS_gpu_allocList(&ctx->params.GPUCmdList);
-    KYGX_BREAK_UNLESS(kygxCmdBufferAlloc(&ctx->GXCmdBuf, 32));
+    KYGX_BREAK_UNLESS(kygxCmdBufferAlloc(&ctx->GXCmdBuf, GLASS_GX_CMD_BUFFER_SIZE));
 
     GLASS_vsyncBarrier_init(&ctx->vsyncBarrier);
 
+    // Fences.
+    ctx->issuedFence = 0;
+    ctx->completedFence = 0;
+    ctx->numQueuedCmds = 0;
+
+    // Memory.
+    GLASS_bufferPool_init(&ctx->bufferPool);
+    ctx->numDirtyRanges = 0;
+    GLASS_scratch_init(&ctx->scratch, ctx->params.scratchSize);
+    GLASS_transient_init(&ctx->transientPool);
+
+    // Stats.
+    memset(&ctx->frameStats, 0, sizeof(GLASSFrameStats));
+    memset(&ctx->lastFrameStats, 0, sizeof(GLASSFrameStats));
+
     // Pixel alignment.
     ctx->packAlignment = 4;
     ctx->unpackAlignment = 4;
@@ -42,6 +63,7 @@ void GLASS_context_initCommon(CtxCommon* ctx, const GLASSCtxParams* ctxParams) {
     // Buffers.
     ctx->arrayBuffer = GLASS_INVALID_OBJECT;
     ctx->elementArrayBuffer = GLASS_INVALID_OBJECT;
+    ctx->pixelPackBuffer = GLASS_INVALID_OBJECT;
 
     // Framebuffer.
     ctx->framebuffer[0] = GLASS_INVALID_OBJECT;
@@ -199,6 +221,15 @@ void GLASS_context_initCommon(CtxCommon* ctx, const GLASSCtxParams* ctxParams) {
 void GLASS_context_cleanupCommon(CtxCommon* ctx) {
     KYGX_ASSERT(ctx);
 
+    // Pooled buffers might still be in use.
+    if (ctx->numQueuedCmds)
+        GLASS_context_flush(ctx, true);
+
+    GLASS_context_waitFence(ctx, ctx->issuedFence);
+    GLASS_bufferPool_destroy(&ctx->bufferPool);
+    GLASS_scratch_destroy(&ctx->scratch);
+    GLASS_transient_destroy(&ctx->transientPool);
+
     if (ctx == g_Context)
         GLASS_context_bind(NULL);
 
@@ -242,6 +273,38 @@ void GLASS_context_bind(CtxCommon* ctx) {
     }
 }
 
+// Flush ranges in batches of three, which are processed before the command list.
+static void flushDirtyRanges(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+
+    KYGXFlushCacheRegionsBuffer buffers[3];
+    size_t numBuffers = 0;
+
+    for (size_t i = 0; i < ctx->numDirtyRanges; ++i) {
+        const DirtyRange* range = &ctx->dirtyRanges[i];
+        buffers[numBuffers].addr = (const void*)range->start;
+        buffers[numBuffers].size = range->end - range->start;
+        ctx->frameStats.flushedBytes += buffers[numBuffers].size;
+        ++numBuffers;
+
+        if ((numBuffers == 3) || (i == (ctx->numDirtyRanges - 1))) {
+            kygxAddFlushCacheRegions(&ctx->GXCmdBuf, &buffers[0], (numBuffers > 1) ? &buffers[1] : NULL, (numBuffers > 2) ? &buffers[2] : NULL);
+            numBuffers = 0;
+        }
+    }
+
+    ctx->frameStats.numFlushRegions += ctx->numDirtyRanges;
+    ctx->numDirtyRanges = 0;
+}
+
+static void signalFence(void* wrapped) {
+    CtxCommon* ctx = (CtxCommon*)wrapped;
+    KYGX_ASSERT(ctx);
+
+    // Command lists complete in submission order.
+    ++ctx->completedFence;
+}
+
 static inline GLsizei renderWidth(CtxCommon* ctx) {
     KYGX_ASSERT(ctx);
 
@@ -465,10 +528,23 @@ void GLASS_context_flush(CtxCommon* ctx, bool send) {
         // Swap GPU command lists.
         void* addr = NULL;
         size_t size = 0;
-        if (!GLASS_gpu_swapListBuffers(&ctx->params.GPUCmdList, &addr, &size))
+        if (!GLASS_gpu_swapListBuffers(&ctx->params.GPUCmdList, &addr, &size)) {
+            // Queued transfers still need a fence of their own.
+            if (ctx->numQueuedCmds) {
+                const bool isBound = GLASS_context_isBound(ctx);
+                if (isBound)
+                    kygxLock();
+
+                GLASS_context_finalizeTransfer(ctx);
+
+                if (isBound)
+                    kygxUnlock(true);
+            }
+
             return;
+        }
 
-        // Flush all linear memory if required.
+        // Flush all linear memory if required, or only the ranges that were written.
         if (ctx->params.flushAllLinearMem) {
 #ifdef KYGX_BAREMETAL
             void* flushBase = (void*)FCRAM_BASE;
@@ -481,6 +557,10 @@ void GLASS_context_flush(CtxCommon* ctx, bool send) {
 #endif // KYGX_BAREMETAL
 
             kygxSyncFlushSingleBuffer(flushBase, flushSize);
+            ctx->frameStats.flushedBytes += flushSize;
+            ++ctx->frameStats.numFlushRegions;
+        } else {
+            GLASS_context_markDirty(ctx, addr, size);
         }
 
         // Send GPU commands.
@@ -488,14 +568,127 @@ void GLASS_context_flush(CtxCommon* ctx, bool send) {
         if (isBound)
             kygxLock();
 
-        kygxAddProcessCommandList(&ctx->GXCmdBuf, addr, size, false, !ctx->params.flushAllLinearMem);
-        kygxCmdBufferFinalize(&ctx->GXCmdBuf, NULL, NULL);
+        flushDirtyRanges(ctx);
+        kygxAddProcessCommandList(&ctx->GXCmdBuf, addr, size, false, false);
+        kygxCmdBufferFinalize(&ctx->GXCmdBuf, signalFence, ctx);
+        ++ctx->issuedFence;
+        ++ctx->frameStats.numSubmits;
+        ctx->numQueuedCmds = 0;
 
         if (isBound)
             kygxUnlock(true);
     }
 }
 
+void GLASS_context_waitFence(CtxCommon* ctx, u32 fence) {
+    KYGX_ASSERT(ctx);
+
+    if (GLASS_context_isFenceDone(ctx, fence))
+        return;
+
+    // Make sure the fence has been sent.
+    if (GLASS_context_isFencePending(ctx, fence)) {
+        GLASS_context_flush(ctx, true);
+
+        // Nothing was pending.
+        if (GLASS_context_isFencePending(ctx, fence))
+            return;
+    }
+
+    while (!GLASS_context_isFenceDone(ctx, fence))
+        kygxWaitCompletion();
+}
+
+// Close the GX commands added so far with a fence of their own.
+// Pending draws must be sent first, or their fence would complete early.
+u32 GLASS_context_finalizeTransfer(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+
+    kygxCmdBufferFinalize(&ctx->GXCmdBuf, signalFence, ctx);
+    ctx->numQueuedCmds = 0;
+    return ++ctx->issuedFence;
+}
+
+// Make room for GX commands that are left open, to be finalized along with the next submit.
+// Pending commands are sent first if the new ones wouldn't fit in the command buffer.
+void GLASS_context_reserveTransfer(CtxCommon* ctx, size_t numCmds) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(numCmds <= GLASS_MAX_QUEUED_GX_CMDS);
+
+    if ((ctx->numQueuedCmds + numCmds) > GLASS_MAX_QUEUED_GX_CMDS)
+        GLASS_context_flush(ctx, true);
+
+    ctx->numQueuedCmds += numCmds;
+}
+
+void GLASS_context_markDirty(CtxCommon* ctx, const void* addr, size_t size) {
+    KYGX_ASSERT(ctx);
+
+    if (ctx->params.flushAllLinearMem || !addr || !size)
+        return;
+
+    const u32 start = (u32)addr & ~(CACHE_LINE_SIZE - 1);
+    const u32 end = ((u32)addr + size + (CACHE_LINE_SIZE - 1)) & ~(CACHE_LINE_SIZE - 1);
+
+    // Find the first range that ends at or after the new one starts.
+    size_t index = 0;
+    while ((index < ctx->numDirtyRanges) && (ctx->dirtyRanges[index].end < start))
+        ++index;
+
+    // Merge with overlapping or adjacent ranges.
+    if ((index < ctx->numDirtyRanges) && (ctx->dirtyRanges[index].start <= end)) {
+        DirtyRange* range = &ctx->dirtyRanges[index];
+        range->start = GLASS_MIN(range->start, start);
+        range->end = GLASS_MAX(range->end, end);
+
+        size_t next = index + 1;
+        while ((next < ctx->numDirtyRanges) && (ctx->dirtyRanges[next].start <= range->end)) {
+            range->end = GLASS_MAX(range->end, ctx->dirtyRanges[next].end);
+            ++next;
+        }
+
+        const size_t numMerged = next - (index + 1);
+        if (numMerged) {
+            memmove(&ctx->dirtyRanges[index + 1], &ctx->dirtyRanges[next], (ctx->numDirtyRanges - next) * sizeof(DirtyRange));
+            ctx->numDirtyRanges -= numMerged;
+        }
+
+        return;
+    }
+
+    // No space left, merge the two closest ranges.
+    if (ctx->numDirtyRanges == GLASS_MAX_DIRTY_RANGES) {
+        size_t closest = 0;
+        for (size_t i = 1; i < (ctx->numDirtyRanges - 1); ++i) {
+            const u32 gap = ctx->dirtyRanges[i + 1].start - ctx->dirtyRanges[i].end;
+            if (gap < (ctx->dirtyRanges[closest + 1].start - ctx->dirtyRanges[closest].end))
+                closest = i;
+        }
+
+        ctx->dirtyRanges[closest].end = ctx->dirtyRanges[closest + 1].end;
+        memmove(&ctx->dirtyRanges[closest + 1], &ctx->dirtyRanges[closest + 2], (ctx->numDirtyRanges - (closest + 2)) * sizeof(DirtyRange));
+        --ctx->numDirtyRanges;
+
+        // The merged range might now touch the new one.
+        GLASS_context_markDirty(ctx, (const void*)start, end - start);
+        return;
+    }
+
+    memmove(&ctx->dirtyRanges[index + 1], &ctx->dirtyRanges[index], (ctx->numDirtyRanges - index) * sizeof(DirtyRange));
+    ctx->dirtyRanges[index].start = start;
+    ctx->dirtyRanges[index].end = end;
+    ++ctx->numDirtyRanges;
+}
+
+void GLASS_context_endFrame(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+    memcpy(&ctx->lastFrameStats, &ctx->frameStats, sizeof(GLASSFrameStats));
+    memset(&ctx->frameStats, 0, sizeof(GLASSFrameStats));
+
+    // Free storage the GPU is done with, even if no buffer is allocated for a while.
+    GLASS_bufferPool_collect(ctx);
+}
+
 #ifndef GLASS_NO_MERCY
 void GLASS_context_setError(GLenum error) {
     KYGX_ASSERT(g_Context);
@@ -19,6 +19,22 @@ typedef struct {
     KYGXCmdBuffer GXCmdBuf;    // GX command buffer.
     VSyncBarrier vsyncBarrier; // VSync barrier.
 
+    // Fences
+    u32 issuedFence;             // Last fence sent to the GPU.
+    volatile u32 completedFence; // Last fence completed by the GPU.
+    size_t numQueuedCmds;        // Num of GX commands waiting for the next submit.
+
+    // Memory
+    BufferPool bufferPool;                          // Recycled buffer storage.
+    DirtyRange dirtyRanges[GLASS_MAX_DIRTY_RANGES]; // Memory written since the last submit, sorted by address.
+    size_t numDirtyRanges;                          // Num of dirty ranges.
+    ScratchArena scratch;                           // Temporary linear buffers.
+    TransientPool transientPool;                    // Storage for render targets living within a frame.
+
+    // Stats
+    GLASSFrameStats frameStats;     // Stats of the current frame.
+    GLASSFrameStats lastFrameStats; // Stats of the last completed frame.
+
     // Pixel alignment
     u8 packAlignment;   // Alignment required when reading the framebuffer.
     u8 unpackAlignment; // Alignment required when uploading textures.
@@ -26,6 +42,7 @@ typedef struct {
     // Buffers
     GLuint arrayBuffer;        // GL_ARRAY_BUFFER
     GLuint elementArrayBuffer; // GL_ELEMENT_ARRAY_BUFFER  
+    GLuint pixelPackBuffer;    // GL_PIXEL_PACK_BUFFER_NV
 
     // Framebuffer
     GLuint framebuffer[2]; // Bound framebuffer object.
@@ -132,8 +149,12 @@ typedef struct {
     GLASSFogLUT fogLut;
     u32 flags;
     GLenum lastError;
+    u32 issuedFence;
+    volatile u32 completedFence;
+    size_t numQueuedCmds;
     GLuint arrayBuffer;
     GLuint elementArrayBuffer;
+    GLuint pixelPackBuffer;
     GLuint renderbuffer;
     u32 clearColor;
     GLint viewportX;
@@ -175,6 +196,13 @@ typedef struct {
     GLuint textureUnits[GLASS_NUM_TEX_UNITS];
     KYGXCmdBuffer GXCmdBuf;
     VSyncBarrier vsyncBarrier;
+    BufferPool bufferPool;
+    DirtyRange dirtyRanges[GLASS_MAX_DIRTY_RANGES];
+    size_t numDirtyRanges;
+    ScratchArena scratch;
+    TransientPool transientPool;
+    GLASSFrameStats frameStats;
+    GLASSFrameStats lastFrameStats;
     GLASSCtxParams params;
     CombinerInfo combiners[GLASS_NUM_COMBINER_STAGES];
     AttributeInfo attribs[GLASS_NUM_ATTRIB_REGS];
@@ -217,6 +245,12 @@ bool GLASS_context_isBound(CtxCommon* ctx);
 void GLASS_context_bind(CtxCommon* ctx);
 void GLASS_context_flush(CtxCommon* ctx, bool send);
 
+void GLASS_context_waitFence(CtxCommon* ctx, u32 fence);
+u32 GLASS_context_finalizeTransfer(CtxCommon* ctx);
+void GLASS_context_reserveTransfer(CtxCommon* ctx, size_t numCmds);
+void GLASS_context_markDirty(CtxCommon* ctx, const void* addr, size_t size);
+void GLASS_context_endFrame(CtxCommon* ctx);
+
 #if defined(GLASS_NO_MERCY)
 #define GLASS_context_setError(err) KYGX_UNREACHABLE(#err)
 #else
@@ -228,4 +262,21 @@ static inline size_t GLASS_context_getFBIndex(CtxCommon* ctx) {
     return (ctx->params.targetSide == GLASS_SIDE_RIGHT) ? 1 : 0;
 }
 
+// Fence of the commands that have not been sent yet.
+static inline u32 GLASS_context_getPendingFence(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+    return ctx->issuedFence + 1;
+}
+
+static inline bool GLASS_context_isFenceDone(CtxCommon* ctx, u32 fence) {
+    KYGX_ASSERT(ctx);
+    return (s32)(ctx->completedFence - fence) >= 0;
+}
+
+// Whether the fence belongs to commands that haven't been sent yet.
+static inline bool GLASS_context_isFencePending(CtxCommon* ctx, u32 fence) {
+    KYGX_ASSERT(ctx);
+    return (s32)(fence - ctx->issuedFence) > 0;
+}
+
 #endif /* _GLASS_BASE_CONTEXT_H */
\ No newline at end of file
@@ -0,0 +1,348 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * OpenGL ETC1 data is a row-major list of 4x4 blocks, starting from the
+ * bottom of the image, each one being a big endian 64-bit word. The PICA
+ * expects the image flipped vertically (as for any other format), with
+ * blocks grouped in 8x8 tiles of 2x2 blocks, and each word in little
+ * endian. ETC1A4 blocks are preceded by a little endian 64-bit word of
+ * 4-bit alpha values, in column-major order.
+ *
+ * Flipping a block reverses the rows of its pixel indices; when the
+ * block is split in top and bottom halves, the halves are swapped too.
+ * Swapping a differential block negates its deltas, and the one value
+ * that can't be negated (-4) falls back to an individual block.
+ *
+ * The encoder works directly in native order: for each block it tries
+ * both subblock orientations, uses differential colors when the two
+ * averages are close enough, and picks the modifier table with the
+ * lowest squared error for each half. There's no search around the
+ * averages, trading some quality for speed.
+ */
+
+#include <KYGX/Utility.h>
+
+#include "Base/ETC.h"
+
+#include <string.h> // memcpy
+
+#define BLOCK_SIZE 8
+#define BLOCK_FLAG_FLIP (1ull << 32)
+#define BLOCK_FLAG_DIFF (1ull << 33)
+
+static const u8 g_Modifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+    { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+typedef struct {
+    u8 colors[2][3]; // Quantized colors of each half.
+    u8 tables[2];    // Modifier table of each half.
+    u16 indices[2];  // Pixel index planes (MSB, LSB).
+    bool diff;       // Colors are differential.
+    u32 error;       // Squared error.
+} EncodedBlock;
+
+static inline u64 readBE(const u8* p) {
+    u64 v = 0;
+    for (size_t i = 0; i < 8; ++i)
+        v = (v << 8) | p[i];
+
+    return v;
+}
+
+static inline u64 readLE(const u8* p) {
+    u64 v = 0;
+    for (size_t i = 0; i < 8; ++i)
+        v |= (u64)p[i] << (i * 8);
+
+    return v;
+}
+
+static inline void writeLE(u8* p, u64 v) {
+    for (size_t i = 0; i < 8; ++i)
+        p[i] = (v >> (i * 8)) & 0xFF;
+}
+
+// Flip a 4x4 grid of column-major fields.
+static inline u64 flipFields(u64 v, size_t fieldBits) {
+    const u64 mask = (1ull << fieldBits) - 1;
+    u64 out = 0;
+
+    for (size_t x = 0; x < 4; ++x) {
+        for (size_t y = 0; y < 4; ++y) {
+            const u64 field = (v >> (((x * 4) + y) * fieldBits)) & mask;
+            out |= field << (((x * 4) + (3 - y)) * fieldBits);
+        }
+    }
+
+    return out;
+}
+
+// Swap the two halves of a block, assumes the color bits are in the high word.
+static u64 swapHalves(u64 block) {
+    u64 out = block & ~(0xFFFFFFull << 40) & ~(0x3Full << 34);
+
+    // Swap table codewords.
+    out |= ((block >> 37) & 0x7) << 34;
+    out |= ((block >> 34) & 0x7) << 37;
+
+    if (!(block & BLOCK_FLAG_DIFF)) {
+        // Swap the 4-bit colors of each channel.
+        for (size_t i = 0; i < 3; ++i) {
+            const u64 channel = (block >> (40 + (i * 8))) & 0xFF;
+            out |= (((channel & 0xF) << 4) | (channel >> 4)) << (40 + (i * 8));
+        }
+
+        return out;
+    }
+
+    bool representable = true;
+    u8 bases[3];
+    s8 deltas[3];
+
+    for (size_t i = 0; i < 3; ++i) {
+        const u8 channel = (block >> (40 + (i * 8))) & 0xFF;
+        const s8 delta = (s8)((channel & 0x7) << 5) >> 5;
+        bases[i] = (channel >> 3) + delta;
+        deltas[i] = -delta;
+        representable &= (deltas[i] <= 3);
+    }
+
+    if (representable) {
+        for (size_t i = 0; i < 3; ++i)
+            out |= (u64)((bases[i] << 3) | (deltas[i] & 0x7)) << (40 + (i * 8));
+
+        return out;
+    }
+
+    // Fall back to 4-bit colors.
+    out &= ~BLOCK_FLAG_DIFF;
+    for (size_t i = 0; i < 3; ++i) {
+        const u8 channel = (block >> (40 + (i * 8))) & 0xFF;
+        const u8 first = bases[i] >> 1;
+        const u8 second = (channel >> 3) >> 1;
+        out |= (u64)((first << 4) | second) << (40 + (i * 8));
+    }
+
+    return out;
+}
+
+static u64 flipBlock(u64 block) {
+    // Pixel indices are stored as two 16-bit planes.
+    const u64 msb = flipFields((block >> 16) & 0xFFFF, 1);
+    const u64 lsb = flipFields(block & 0xFFFF, 1);
+    u64 out = (block & ~0xFFFFFFFFull) | (msb << 16) | lsb;
+
+    if (block & BLOCK_FLAG_FLIP)
+        out = swapHalves(out);
+
+    return out;
+}
+
+void GLASS_etc_toNative(const u8* src, u8* dst, size_t width, size_t height, bool hasAlpha) {
+    KYGX_ASSERT(src);
+    KYGX_ASSERT(dst);
+    KYGX_ASSERT(kygxIsAligned(width, 8));
+    KYGX_ASSERT(kygxIsAligned(height, 8));
+
+    const size_t blockSize = hasAlpha ? (BLOCK_SIZE * 2) : BLOCK_SIZE;
+    const size_t blocksPerRow = width >> 2;
+    const size_t blocksPerColumn = height >> 2;
+
+    for (size_t by = 0; by < blocksPerColumn; ++by) {
+        // Native rows start from the top.
+        const size_t nativeY = blocksPerColumn - 1 - by;
+
+        for (size_t bx = 0; bx < blocksPerRow; ++bx) {
+            const size_t tile = ((nativeY >> 1) * (blocksPerRow >> 1)) + (bx >> 1);
+            const size_t index = (tile << 2) + ((nativeY & 1) << 1) + (bx & 1);
+            u8* out = dst + (index * blockSize);
+
+            if (hasAlpha) {
+                writeLE(out, flipFields(readLE(src), 4));
+                src += BLOCK_SIZE;
+                out += BLOCK_SIZE;
+            }
+
+            writeLE(out, flipBlock(readBE(src)));
+            src += BLOCK_SIZE;
+        }
+    }
+}
+
+static inline u8 clampColor(int v) { return (v < 0) ? 0 : ((v > 255) ? 255 : v); }
+
+// Pixel index bits belonging to a half.
+static inline u16 getHalfMask(bool flip, size_t half) {
+    if (flip)
+        return half ? 0xCCCC : 0x3333;
+
+    return half ? 0xFF00 : 0x00FF;
+}
+
+// Choose the table for a half, given its expanded base color.
+static u32 encodeHalf(const u8 pixels[16][3], bool flip, size_t half, const u8 base[3], EncodedBlock* out) {
+    u32 bestError = UINT32_MAX;
+
+    for (size_t table = 0; table < 8; ++table) {
+        u32 error = 0;
+        u16 msb = 0;
+        u16 lsb = 0;
+
+        for (size_t x = 0; x < 4; ++x) {
+            for (size_t y = 0; y < 4; ++y) {
+                if ((flip ? (y >> 1) : (x >> 1)) != half)
+                    continue;
+
+                const u8* pixel = pixels[(y * 4) + x];
+                u32 bestPixelError = UINT32_MAX;
+                size_t bestIndex = 0;
+
+                // Index 0: +small, 1: +large, 2: -small, 3: -large.
+                for (size_t index = 0; index < 4; ++index) {
+                    const int modifier = (index & 2) ? -g_Modifiers[table][index & 1] : g_Modifiers[table][index & 1];
+                    u32 pixelError = 0;
+                    for (size_t c = 0; c < 3; ++c) {
+                        const int d = clampColor(base[c] + modifier) - pixel[c];
+                        pixelError += d * d;
+                    }
+
+                    if (pixelError < bestPixelError) {
+                        bestPixelError = pixelError;
+                        bestIndex = index;
+                    }
+                }
+
+                error += bestPixelError;
+                msb |= (bestIndex >> 1) << ((x * 4) + y);
+                lsb |= (bestIndex & 1) << ((x * 4) + y);
+            }
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            out->tables[half] = table;
+            out->indices[0] = (out->indices[0] & ~getHalfMask(flip, half)) | msb;
+            out->indices[1] = (out->indices[1] & ~getHalfMask(flip, half)) | lsb;
+        }
+    }
+
+    return bestError;
+}
+
+static void encodeOrientation(const u8 pixels[16][3], bool flip, EncodedBlock* out) {
+    u32 sums[2][3] = { { 0 } };
+
+    for (size_t y = 0; y < 4; ++y) {
+        for (size_t x = 0; x < 4; ++x) {
+            const size_t half = flip ? (y >> 1) : (x >> 1);
+            for (size_t c = 0; c < 3; ++c)
+                sums[half][c] += pixels[(y * 4) + x][c];
+        }
+    }
+
+    // Try differential colors first, they have more precision.
+    out->diff = true;
+    for (size_t c = 0; c < 3; ++c) {
+        const int first = ((sums[0][c] >> 3) * 31 + 127) / 255;
+        const int second = ((sums[1][c] >> 3) * 31 + 127) / 255;
+        out->colors[0][c] = first;
+        out->colors[1][c] = second;
+
+        if (((second - first) < -4) || ((second - first) > 3))
+            out->diff = false;
+    }
+
+    u8 bases[2][3];
+    for (size_t half = 0; half < 2; ++half) {
+        for (size_t c = 0; c < 3; ++c) {
+            if (out->diff) {
+                bases[half][c] = (out->colors[half][c] << 3) | (out->colors[half][c] >> 2);
+            } else {
+                out->colors[half][c] = ((sums[half][c] >> 3) * 15 + 127) / 255;
+                bases[half][c] = out->colors[half][c] * 17;
+            }
+        }
+    }
+
+    out->indices[0] = 0;
+    out->indices[1] = 0;
+    out->error = encodeHalf(pixels, flip, 0, bases[0], out) + encodeHalf(pixels, flip, 1, bases[1], out);
+}
+
+static u64 packBlock(const EncodedBlock* block, bool flip) {
+    u64 out = ((u64)block->tables[0] << 37) | ((u64)block->tables[1] << 34) | ((u64)block->indices[0] << 16) | block->indices[1];
+
+    if (flip)
+        out |= BLOCK_FLAG_FLIP;
+
+    // Channels are stored as R, G, B from the top.
+    for (size_t c = 0; c < 3; ++c) {
+        const size_t shift = 56 - (c * 8);
+        if (block->diff) {
+            const int delta = block->colors[1][c] - block->colors[0][c];
+            out |= (u64)((block->colors[0][c] << 3) | (delta & 0x7)) << shift;
+        } else {
+            out |= (u64)((block->colors[0][c] << 4) | block->colors[1][c]) << shift;
+        }
+    }
+
+    if (block->diff)
+        out |= BLOCK_FLAG_DIFF;
+
+    return out;
+}
+
+void GLASS_etc_encode(const u8* src, u8* dst, size_t width, size_t height, size_t srcComponents, bool hasAlpha) {
+    KYGX_ASSERT(src);
+    KYGX_ASSERT(dst);
+    KYGX_ASSERT((srcComponents == 3) || (srcComponents == 4));
+    KYGX_ASSERT(kygxIsAligned(width, 8));
+    KYGX_ASSERT(kygxIsAligned(height, 8));
+
+    const size_t blockSize = hasAlpha ? (BLOCK_SIZE * 2) : BLOCK_SIZE;
+    const size_t blocksPerRow = width >> 2;
+    const size_t blocksPerColumn = height >> 2;
+    const size_t srcStride = width * srcComponents;
+
+    for (size_t by = 0; by < blocksPerColumn; ++by) {
+        for (size_t bx = 0; bx < blocksPerRow; ++bx) {
+            u8 pixels[16][3];
+            u64 alpha = 0;
+
+            // Gather the block, native rows start from the top.
+            for (size_t y = 0; y < 4; ++y) {
+                const u8* row = src + ((height - 1 - ((by * 4) + y)) * srcStride) + (bx * 4 * srcComponents);
+                for (size_t x = 0; x < 4; ++x) {
+                    const u8* pixel = row + (x * srcComponents);
+                    memcpy(pixels[(y * 4) + x], pixel, 3);
+
+                    const u64 a = (srcComponents == 4) ? (pixel[3] >> 4) : 0xF;
+                    alpha |= a << (((x * 4) + y) * 4);
+                }
+            }
+
+            EncodedBlock sideBySide;
+            EncodedBlock topBottom;
+            encodeOrientation(pixels, false, &sideBySide);
+            encodeOrientation(pixels, true, &topBottom);
+
+            const bool flip = topBottom.error < sideBySide.error;
+            const size_t tile = ((by >> 1) * (blocksPerRow >> 1)) + (bx >> 1);
+            const size_t index = (tile << 2) + ((by & 1) << 1) + (bx & 1);
+            u8* out = dst + (index * blockSize);
+
+            if (hasAlpha) {
+                writeLE(out, alpha);
+                out += BLOCK_SIZE;
+            }
+
+            writeLE(out, packBlock(flip ? &topBottom : &sideBySide, flip));
+        }
+    }
+}
@@ -0,0 +1,15 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_ETC_H
+#define _GLASS_BASE_ETC_H
+
+#include "Base/Types.h"
+
+void GLASS_etc_toNative(const u8* src, u8* dst, size_t width, size_t height, bool hasAlpha);
+void GLASS_etc_encode(const u8* src, u8* dst, size_t width, size_t height, size_t srcComponents, bool hasAlpha);
+
+#endif /* _GLASS_BASE_ETC_H */
@@ -6,8 +6,14 @@
 
 #include <KYGX/Wrappers/DisplayTransfer.h>
 
+#include "Base/Budget.h"
 #include "Base/Context.h"
+#include "Base/MemStats.h"
+#include "Base/Residency.h"
+#include "Base/SubAlloc.h"
 #include "Base/TexManager.h"
+#include "Base/Transient.h"
+#include "Base/VRAM.h"
 #include "Platform/GPU.h"
 #include "Platform/GFX.h"
 
@@ -119,7 +125,15 @@ void glassSetGPUCommandList(GLASSCtx ctx, const GLASSGPUCommandList* list) {
     KYGX_ASSERT(ctx);
     KYGX_ASSERT(list);
 
-    memcpy(&((CtxCommon*)ctx)->params.GPUCmdList, list, sizeof(GLASSGPUCommandList));
+    GLASSGPUCommandList* current = &((CtxCommon*)ctx)->params.GPUCmdList;
+
+    // The previous list now belongs to the application.
+    GLASS_memStats_remove(GLASS_MEMORY_COMMAND_LISTS, current->mainBuffer, current->capacity);
+    GLASS_memStats_remove(GLASS_MEMORY_COMMAND_LISTS, current->secondBuffer, current->capacity);
+    GLASS_memStats_add(GLASS_MEMORY_COMMAND_LISTS, list->mainBuffer, list->capacity, GLASS_INVALID_OBJECT);
+    GLASS_memStats_add(GLASS_MEMORY_COMMAND_LISTS, list->secondBuffer, list->capacity, GLASS_INVALID_OBJECT);
+
+    memcpy(current, list, sizeof(GLASSGPUCommandList));
 }
 
 bool glassHasVSync(GLASSCtx ctx) {
@@ -152,6 +166,47 @@ void glassSetFlushAllLinearMem(GLASSCtx ctx, bool enabled) {
     ((CtxCommon*)ctx)->params.flushAllLinearMem = enabled;
 }
 
+size_t glassGetTextureVRAMBudget(GLASSCtx ctx) {
+    KYGX_ASSERT(ctx);
+    return ((CtxCommon*)ctx)->params.textureVRAMBudget;
+}
+
+void glassSetTextureVRAMBudget(GLASSCtx ctx, size_t budget) {
+    KYGX_ASSERT(ctx);
+    ((CtxCommon*)ctx)->params.textureVRAMBudget = budget;
+}
+
+void glassGetFrameStats(GLASSCtx ctx, GLASSFrameStats* stats) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(stats);
+    memcpy(stats, &((CtxCommon*)ctx)->lastFrameStats, sizeof(GLASSFrameStats));
+}
+
+void glassGetSubAllocStats(GLASSSubAllocStats* stats) {
+    KYGX_ASSERT(stats);
+    GLASS_subAlloc_getStats(stats);
+}
+
+size_t glassGetVRAMBankUsage(KYGXVRAMBank bank) {
+    KYGX_ASSERT(bank != KYGX_ALLOC_VRAM_BANK_ANY);
+    return GLASS_vram_getUsage(bank);
+}
+
+void glassGetMemoryStats(GLASSMemoryStats* stats) {
+    KYGX_ASSERT(stats);
+    GLASS_memStats_get(stats);
+}
+
+size_t glassGetMemoryAllocations(GLASSMemoryAllocation* allocations, size_t max) {
+    KYGX_ASSERT(allocations || !max);
+    return GLASS_memStats_getAllocations(allocations, max);
+}
+
+void glassSetMemoryBudget(size_t linear, size_t vram) { GLASS_budget_setLimits(linear, vram); }
+void glassSetPurgeCallback(GLASSPurgeCallback callback, void* userData) { GLASS_budget_setCallback(callback, userData); }
+
+void glassCompactVRAM(void) { GLASS_vram_compact(); }
+
 GLASSDownscale glassGetDownscale(GLASSCtx ctx) {
     KYGX_ASSERT(ctx);
     return ((CtxCommon*)ctx)->params.downscale;
@@ -279,11 +334,18 @@ static void prepareContextForTransfer(CtxCommon* ctx, TransferParams* leftParams
         GLASS_context_bind(ctx);
         GLASS_context_flush(ctx, true);
         kygxWaitCompletion();
+        GLASS_context_endFrame(ctx);
+
+        // The GPU is idle, move textures around.
+        GLASS_residency_update(ctx);
 
         // Get transfer params for each side.
         getTransferParams(ctx, leftParams, GLASS_SIDE_LEFT);
         getTransferParams(ctx, rightParams, GLASS_SIDE_RIGHT);
 
+        // Render targets used for this frame can be reused by the next one.
+        GLASS_transient_endFrame(ctx);
+
         // Get VSync.
         *hasVSync = ctx->params.vsync;
     }
@@ -0,0 +1,233 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Memory used by GLASS is accounted where it's allocated, as the
+ * allocator hooks can be replaced by the application. The kind of
+ * memory is deduced from the address. In debug mode, every
+ * allocation is also recorded along with the object owning it.
+ */
+#include "Base/Math.h"
+#include "Base/MemStats.h"
+
+#include <string.h> // memcpy
+
+// Free blocks are probed with this granularity.
+#define PROBE_GRANULARITY 0x1000
+
+// Upper bounds for probing.
+#define MAX_PROBE_SIZE 0x10000000
+#define MAX_VRAM_PROBE_SIZE 0x300000
+
+typedef struct AllocRecord {
+    struct AllocRecord* next;   // Next record.
+    GLASSMemoryAllocation info; // Allocation info.
+} AllocRecord;
+
+static GLASSMemoryUsage g_Kinds[GLASS_NUM_MEMORY_KINDS];
+static GLASSMemoryUsage g_Categories[GLASS_NUM_MEMORY_CATEGORIES][GLASS_NUM_MEMORY_KINDS];
+static GLASSMemoryUsage g_TexFormats[GLASS_NUM_TEXTURE_FORMATS];
+
+#ifndef NDEBUG
+static AllocRecord* g_Records = NULL;
+static size_t g_NumRecords = 0;
+#endif // NDEBUG
+
+static inline GLASSMemoryKind getKind(const void* p) {
+    if (glassIsVRAM(p))
+        return GLASS_MEMORY_VRAM;
+
+    return glassIsLinear(p) ? GLASS_MEMORY_LINEAR : GLASS_MEMORY_HEAP;
+}
+
+static inline void addUsage(GLASSMemoryUsage* usage, size_t size) {
+    usage->current += size;
+    ++usage->count;
+
+    if (usage->current > usage->peak)
+        usage->peak = usage->current;
+}
+
+static inline void removeUsage(GLASSMemoryUsage* usage, size_t size) {
+    KYGX_ASSERT(usage->current >= size);
+    KYGX_ASSERT(usage->count);
+
+    usage->current -= size;
+    --usage->count;
+}
+
+#ifndef NDEBUG
+static AllocRecord** findRecord(const void* p) {
+    for (AllocRecord** link = &g_Records; *link; link = &(*link)->next) {
+        if ((*link)->info.address == p)
+            return link;
+    }
+
+    return NULL;
+}
+#endif // NDEBUG
+
+void GLASS_memStats_add(GLASSMemoryCategory category, const void* p, size_t size, GLuint owner) {
+    KYGX_ASSERT(category < GLASS_NUM_MEMORY_CATEGORIES);
+
+    if (!p)
+        return;
+
+    const GLASSMemoryKind kind = getKind(p);
+    addUsage(&g_Kinds[kind], size);
+    addUsage(&g_Categories[category][kind], size);
+
+#ifndef NDEBUG
+    // Tracking is best effort, don't fail the allocation.
+    AllocRecord* record = (AllocRecord*)glassHeapAlloc(sizeof(AllocRecord));
+    if (record) {
+        record->info.address = p;
+        record->info.size = size;
+        record->info.kind = kind;
+        record->info.category = category;
+        record->info.owner = owner;
+        record->next = g_Records;
+        g_Records = record;
+        ++g_NumRecords;
+    }
+#else
+    (void)owner;
+#endif // NDEBUG
+}
+
+void GLASS_memStats_remove(GLASSMemoryCategory category, const void* p, size_t size) {
+    KYGX_ASSERT(category < GLASS_NUM_MEMORY_CATEGORIES);
+
+    if (!p)
+        return;
+
+    const GLASSMemoryKind kind = getKind(p);
+    removeUsage(&g_Kinds[kind], size);
+    removeUsage(&g_Categories[category][kind], size);
+
+#ifndef NDEBUG
+    AllocRecord** link = findRecord(p);
+    if (link) {
+        AllocRecord* record = *link;
+        *link = record->next;
+        glassHeapFree(record);
+        --g_NumRecords;
+    }
+#endif // NDEBUG
+}
+
+void GLASS_memStats_move(GLASSMemoryCategory category, const void* from, const void* to, size_t size) {
+    KYGX_ASSERT(category < GLASS_NUM_MEMORY_CATEGORIES);
+    KYGX_ASSERT(from);
+    KYGX_ASSERT(to);
+
+    const GLASSMemoryKind oldKind = getKind(from);
+    const GLASSMemoryKind newKind = getKind(to);
+    removeUsage(&g_Kinds[oldKind], size);
+    removeUsage(&g_Categories[category][oldKind], size);
+    addUsage(&g_Kinds[newKind], size);
+    addUsage(&g_Categories[category][newKind], size);
+
+#ifndef NDEBUG
+    // Keep the owner.
+    AllocRecord** link = findRecord(from);
+    if (link) {
+        (*link)->info.address = to;
+        (*link)->info.kind = newKind;
+    }
+#endif // NDEBUG
+}
+
+void GLASS_memStats_addTexFormat(size_t format, size_t size) {
+    KYGX_ASSERT(format < GLASS_NUM_TEXTURE_FORMATS);
+    addUsage(&g_TexFormats[format], size);
+}
+
+void GLASS_memStats_removeTexFormat(size_t format, size_t size) {
+    KYGX_ASSERT(format < GLASS_NUM_TEXTURE_FORMATS);
+    removeUsage(&g_TexFormats[format], size);
+}
+
+static void* probeAlloc(GLASSMemoryKind kind, KYGXVRAMBank bank, size_t size) {
+    switch (kind) {
+        case GLASS_MEMORY_HEAP:
+            return glassHeapAlloc(size);
+        case GLASS_MEMORY_LINEAR:
+            return glassLinearAlloc(size);
+        case GLASS_MEMORY_VRAM:
+            return glassVRAMAlloc(size, bank);
+    }
+
+    KYGX_UNREACHABLE("Invalid memory kind!");
+}
+
+static void probeFree(GLASSMemoryKind kind, void* p) {
+    switch (kind) {
+        case GLASS_MEMORY_HEAP:
+            glassHeapFree(p);
+            return;
+        case GLASS_MEMORY_LINEAR:
+            glassLinearFree(p);
+            return;
+        case GLASS_MEMORY_VRAM:
+            glassVRAMFree(p);
+            return;
+    }
+
+    KYGX_UNREACHABLE("Invalid memory kind!");
+}
+
+// Binary search the biggest allocation that succeeds.
+static size_t findLargestBlock(GLASSMemoryKind kind, KYGXVRAMBank bank, size_t limit) {
+    size_t lo = 0;
+    size_t hi = limit / PROBE_GRANULARITY;
+
+    while (lo < hi) {
+        const size_t mid = (lo + hi + 1) >> 1;
+        void* p = probeAlloc(kind, bank, mid * PROBE_GRANULARITY);
+
+        if (p) {
+            probeFree(kind, p);
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return lo * PROBE_GRANULARITY;
+}
+
+void GLASS_memStats_get(GLASSMemoryStats* stats) {
+    KYGX_ASSERT(stats);
+
+    memcpy(stats->kinds, g_Kinds, sizeof(g_Kinds));
+    memcpy(stats->categories, g_Categories, sizeof(g_Categories));
+    memcpy(stats->textureFormats, g_TexFormats, sizeof(g_TexFormats));
+
+    stats->largestFreeBlock[GLASS_MEMORY_HEAP] = findLargestBlock(GLASS_MEMORY_HEAP, KYGX_ALLOC_VRAM_BANK_ANY, MAX_PROBE_SIZE);
+    stats->largestFreeBlock[GLASS_MEMORY_LINEAR] = findLargestBlock(GLASS_MEMORY_LINEAR, KYGX_ALLOC_VRAM_BANK_ANY, MAX_PROBE_SIZE);
+
+    // Blocks can't span both banks.
+    const size_t bankA = findLargestBlock(GLASS_MEMORY_VRAM, KYGX_ALLOC_VRAM_BANK_A, MAX_VRAM_PROBE_SIZE);
+    const size_t bankB = findLargestBlock(GLASS_MEMORY_VRAM, KYGX_ALLOC_VRAM_BANK_B, MAX_VRAM_PROBE_SIZE);
+    stats->largestFreeBlock[GLASS_MEMORY_VRAM] = GLASS_MAX(bankA, bankB);
+}
+
+size_t GLASS_memStats_getAllocations(GLASSMemoryAllocation* allocations, size_t max) {
+#ifndef NDEBUG
+    size_t i = 0;
+    for (const AllocRecord* record = g_Records; record && (i < max); record = record->next) {
+        memcpy(&allocations[i], &record->info, sizeof(GLASSMemoryAllocation));
+        allocations[i++].owner = GLASS_getObjectName(record->info.owner);
+    }
+
+    return g_NumRecords;
+#else
+    (void)allocations;
+    (void)max;
+    return 0;
+#endif // NDEBUG
+}
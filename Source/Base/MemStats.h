@@ -0,0 +1,22 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_MEMSTATS_H
+#define _GLASS_BASE_MEMSTATS_H
+
+#include "Base/Types.h"
+
+void GLASS_memStats_add(GLASSMemoryCategory category, const void* p, size_t size, GLuint owner);
+void GLASS_memStats_remove(GLASSMemoryCategory category, const void* p, size_t size);
+void GLASS_memStats_move(GLASSMemoryCategory category, const void* from, const void* to, size_t size);
+
+void GLASS_memStats_addTexFormat(size_t format, size_t size);
+void GLASS_memStats_removeTexFormat(size_t format, size_t size);
+
+void GLASS_memStats_get(GLASSMemoryStats* stats);
+size_t GLASS_memStats_getAllocations(GLASSMemoryAllocation* allocations, size_t max);
+
+#endif /* _GLASS_BASE_MEMSTATS_H */
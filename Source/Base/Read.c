@@ -4,15 +4,22 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <KYGX/Wrappers/DisplayTransfer.h>
+#include <KYGX/Wrappers/FlushCacheRegions.h>
+#include <KYGX/Wrappers/TextureCopy.h>
 #include <KYGX/Utility.h>
 #include <RIP/Convert.h>
 #include <RIP/Pixels.h>
 #include <RIP/Tiling.h>
 
+#include "Base/BufferPool.h"
 #include "Base/Math.h"
 #include "Base/Read.h"
+#include "Base/Scratch.h"
 #include "Base/TexManager.h"
 
+#include <string.h> // memcpy
+
 static inline size_t getPixelSize(GLenum format) {
     switch (format) {
         case GL_RGBA8_OES:
@@ -45,79 +52,293 @@ static inline RIPPixelFormat getPixelFormat(GLenum format) {
     return 0;
 }
 
-void GLASS_read_colorBuffer(const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat, u8* out) {
+static inline bool getTransferFormat(RIPPixelFormat format, u8* out) {
+    switch (format) {
+        case RIP_PIXELFORMAT_RGBA8:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGBA8;
+            return true;
+        case RIP_PIXELFORMAT_RGB8:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB8;
+            return true;
+        case RIP_PIXELFORMAT_RGB5A1:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB5A1;
+            return true;
+        case RIP_PIXELFORMAT_RGB565:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB565;
+            return true;
+        case RIP_PIXELFORMAT_RGBA4:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGBA4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Tiles covering the rect, and how they map to the output.
+static bool prepareRead(const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat, ReadbackInfo* out) {
     KYGX_ASSERT(fb);
     KYGX_ASSERT(out);
 
     // Get color buffer. Width and height are swapped to account for the rotated screens.
-    u8* cbAddr = NULL;
-    u16 cbWidth = 0;
-    u16 cbHeight = 0;
     GLenum cbFormat = 0;
 
     if (GLASS_OBJ_IS_RENDERBUFFER(fb->colorBuffer)) {
         RenderbufferInfo* cb = (RenderbufferInfo*)fb->colorBuffer;
-        cbAddr = cb->address;
-        cbWidth = cb->height;
-        cbHeight = cb->width;
+        out->cbAddr = cb->address;
+        out->cbWidth = cb->height;
+        out->cbHeight = cb->width;
         cbFormat = cb->format;
     } else if (GLASS_OBJ_IS_TEXTURE(fb->colorBuffer)) {
         RenderbufferInfo cb;
         TextureInfo* tex = (TextureInfo*)fb->colorBuffer;
         GLASS_tex_getAsRenderbuffer(tex, fb->texFace, &cb);
-        cbAddr = cb.address;
-        cbWidth = cb.height;
-        cbHeight = cb.width;
+        out->cbAddr = cb.address;
+        out->cbWidth = cb.height;
+        out->cbHeight = cb.width;
         cbFormat = cb.format;
     } else {
         KYGX_UNREACHABLE("Invalid color buffer!");
     }
 
+    out->cbPixelFormat = getPixelFormat(cbFormat);
+    out->pixelFormat = pixelFormat;
+
     // Prepare coordinates.
     const u16 x0 = GLASS_MAX(0, x);
     const u16 y0 = GLASS_MAX(0, y);
-    const s16 x1 = GLASS_MIN(cbHeight, x + width);
-    const s16 y1 = GLASS_MIN(cbWidth, y + height);
+    const s16 x1 = GLASS_MIN(out->cbHeight, x + width);
+    const s16 y1 = GLASS_MIN(out->cbWidth, y + height);
 
     if (x0 >= x1 || y0 >= y1)
-        return;
+        return false;
 
-    const size_t clippedWidth = x1 - x0;
-    const size_t clippedHeight = y1 - y0;
+    out->x0 = x0;
+    out->y0 = y0;
+    out->clippedWidth = x1 - x0;
+    out->clippedHeight = y1 - y0;
 
-    // Read color buffer.
-    const size_t srcPixelSize = getPixelSize(cbFormat);
+    // Adjust the output buffer in case we read gibberish (coords < 0).
     const size_t dstPixelSize = ripGetPixelFormatBPP(pixelFormat) >> 3;
-    void* tmpBuffer = glassLinearAlloc(cbWidth * cbHeight * GLASS_MAX(srcPixelSize, dstPixelSize));
-    KYGX_ASSERT(tmpBuffer);
+    out->dstOffsetX = x0 - x; // -x if x < 0 else 0
+    out->dstOffsetY = y0 - y; // -y if y < 0 else 0
+    out->dstStride = kygxAlignUp(width * dstPixelSize, GLASS_context_getBound()->packAlignment);
 
-    const RIPPixelFormat cbPixelFormat = getPixelFormat(cbFormat);
-    KYGX_ASSERT(ripTilingCanUseHW(cbWidth, cbHeight, cbPixelFormat));
+    // Only the tiles covering the rect are read. Color buffer rows are OpenGL columns.
+    out->tiles.x = kygxAlignDown(y0, 8);
+    out->tiles.y = kygxAlignDown(x0, 8);
+    out->tiles.width = kygxAlignUp(y1, 8) - out->tiles.x;
+    out->tiles.height = kygxAlignUp(x1, 8) - out->tiles.y;
 
-    bool ret = ripUntile(cbAddr, tmpBuffer, cbWidth, cbHeight, cbPixelFormat);
-    KYGX_ASSERT(ret);
+    const size_t srcPixelSize = getPixelSize(cbFormat) >> 3;
+    out->stagingSize = out->tiles.width * out->tiles.height * GLASS_MAX(srcPixelSize, dstPixelSize);
+    out->staging = NULL;
+    return true;
+}
 
-    ret = ripSwapPixelBytes(tmpBuffer, tmpBuffer, cbWidth, cbHeight, cbPixelFormat, false);
-    KYGX_ASSERT(ret);
+// Untile and convert with a single display transfer, straight from the color buffer.
+static bool transferTiles(CtxCommon* ctx, const ReadbackInfo* info) {
+    KYGXDisplayTransferFlags transferFlags;
+    if (!getTransferFormat(info->cbPixelFormat, &transferFlags.srcFmt) || !getTransferFormat(info->pixelFormat, &transferFlags.dstFmt))
+        return false;
 
-    // Do pixel conversion.
-    ripConvertPixels(tmpBuffer, tmpBuffer, cbWidth, cbHeight, cbPixelFormat, pixelFormat);
+    if (!ripTilingCanUseHW(info->tiles.width, info->tiles.height, info->pixelFormat))
+        return false;
 
-    // Read lines.
-    // Skip x > 0 lines, y > 0 pixels.
-    const u8* src = &((const u8*)tmpBuffer)[((cbWidth * x0) + y0) * dstPixelSize];
+    // Rows are read whole from the first tile, which would go past the end of the color buffer on the last row.
+    if (info->tiles.x && ((info->tiles.y + info->tiles.height) >= info->cbHeight))
+        return false;
 
-    // Adjust the output buffer in case we read gibberish (coords < 0).
-    const size_t dstOffsetX = x0 - x; // -x if x < 0 else 0 
-    const size_t dstOffsetY = y0 - y; // -y if y < 0 else 0
-    u8* dst = &out[((width * dstOffsetY) + dstOffsetX) * dstPixelSize];
-
-    // TODO: this might give incorrect results when coords are negative.
-    for (size_t r = 0; r < clippedHeight; ++r) {
-        for (size_t c = 0; c < clippedWidth; ++c) {
-            memcpy(&dst[(((r + dstOffsetY) * width) + c + dstOffsetX) * dstPixelSize], &src[((c * cbWidth) + r) * dstPixelSize], dstPixelSize);
+    transferFlags.mode = KYGX_DISPLAYTRANSFER_MODE_T2L;
+    transferFlags.downscale = KYGX_DISPLAYTRANSFER_DOWNSCALE_NONE;
+    transferFlags.verticalFlip = false;
+    transferFlags.blockMode32 = false;
+
+    // The input starts at the first tile of the rect, the output width crops each row.
+    const size_t srcPixelSize = ripGetPixelFormatBPP(info->cbPixelFormat) >> 3;
+    const size_t rowSize = info->cbWidth * 8 * srcPixelSize;
+    const u8* src = info->cbAddr + ((info->tiles.y >> 3) * rowSize) + ((info->tiles.x >> 3) * 64 * srcPixelSize);
+    kygxAddDisplayTransferChecked(&ctx->GXCmdBuf, src, info->staging, info->cbWidth, info->tiles.height, info->tiles.width, info->tiles.height, &transferFlags);
+    return true;
+}
+
+// Copy the tiles out of the color buffer, they're untiled and converted on the CPU.
+static void copyTiles(CtxCommon* ctx, const ReadbackInfo* info) {
+    KYGXTextureCopySurface srcSurface;
+    srcSurface.addr = info->cbAddr;
+    srcSurface.width = info->cbWidth;
+    srcSurface.height = info->cbHeight;
+    srcSurface.pixelSize = ripGetPixelFormatBPP(info->cbPixelFormat) >> 3;
+    srcSurface.rotated = true;
+
+    KYGXTextureCopySurface dstSurface;
+    dstSurface.addr = info->staging;
+    dstSurface.width = info->tiles.width;
+    dstSurface.height = info->tiles.height;
+    dstSurface.pixelSize = srcSurface.pixelSize;
+    dstSurface.rotated = true;
+
+    KYGXTextureCopyRect dstRect;
+    dstRect.x = 0;
+    dstRect.y = 0;
+    dstRect.width = info->tiles.width;
+    dstRect.height = info->tiles.height;
+
+    kygxAddRectCopy(&ctx->GXCmdBuf, &srcSurface, &info->tiles, &dstSurface, &dstRect);
+}
+
+// Queue the GPU side of the read, after any pending draw.
+static void queueRead(ReadbackInfo* info) {
+    KYGX_ASSERT(info->staging);
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    GLASS_context_flush(ctx, true);
+
+    KYGXFlushCacheRegionsBuffer flushStaging;
+    flushStaging.addr = info->staging;
+    flushStaging.size = info->stagingSize;
+
+    kygxLock();
+    kygxAddFlushCacheRegions(&ctx->GXCmdBuf, &flushStaging, NULL, NULL);
+
+    info->transferred = transferTiles(ctx, info);
+    if (!info->transferred)
+        copyTiles(ctx, info);
+
+    info->fence = GLASS_context_finalizeTransfer(ctx);
+    kygxUnlock(true);
+}
+
+// Wait for the GPU, then write the rect to the output.
+static void resolveRead(const ReadbackInfo* info, u8* out) {
+    KYGX_ASSERT(info->staging);
+    KYGX_ASSERT(out);
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    if (!GLASS_context_isFenceDone(ctx, info->fence))
+        GLASS_context_waitFence(ctx, info->fence);
+
+    // Avoid possible prefetches.
+    kygxInvalidateDataCache(info->staging, info->stagingSize);
+
+    bool ret;
+    if (info->transferred) {
+        ret = ripSwapPixelBytes(info->staging, info->staging, info->tiles.width, info->tiles.height, info->pixelFormat, false);
+        KYGX_ASSERT(ret);
+    } else {
+        ret = ripConvertInPlaceFromNative(info->staging, info->tiles.width, info->tiles.height, info->cbPixelFormat, false);
+        KYGX_ASSERT(ret);
+
+        ret = ripConvertPixels(info->staging, info->staging, info->tiles.width, info->tiles.height, info->cbPixelFormat, info->pixelFormat);
+        KYGX_ASSERT(ret);
+    }
+
+    const size_t dstPixelSize = ripGetPixelFormatBPP(info->pixelFormat) >> 3;
+    const size_t srcStride = info->tiles.width * dstPixelSize;
+
+    // Each output row is a column of the staging buffer.
+    for (size_t r = 0; r < info->clippedHeight; ++r) {
+        const u8* src = &info->staging[((info->x0 - info->tiles.y) * srcStride) + ((info->y0 + r - info->tiles.x) * dstPixelSize)];
+        u8* dst = &out[((r + info->dstOffsetY) * info->dstStride) + (info->dstOffsetX * dstPixelSize)];
+
+        for (size_t c = 0; c < info->clippedWidth; ++c) {
+            memcpy(dst, src, dstPixelSize);
+            src += srcStride;
+            dst += dstPixelSize;
+        }
+    }
+}
+
+bool GLASS_read_colorBuffer(const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat, u8* out) {
+    ReadbackInfo info;
+    if (!prepareRead(fb, x, y, width, height, pixelFormat, &info))
+        return true;
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    info.staging = GLASS_scratch_alloc(ctx, info.stagingSize);
+    if (!info.staging)
+        return false;
+
+    queueRead(&info);
+    resolveRead(&info, out);
+    GLASS_scratch_free(ctx, info.staging);
+    return true;
+}
+
+// Write a pending read to the pack buffer and free it.
+static void resolvePackRead(BufferInfo* pack, ReadbackInfo* info) {
+    u8* dst = pack->address + info->packOffset;
+    resolveRead(info, dst);
+    GLASS_context_markDirty(GLASS_context_getBound(), dst, info->packSize);
+
+    glassLinearFree(info->staging);
+    glassHeapFree(info);
+}
+
+bool GLASS_read_queuePack(BufferInfo* pack, size_t offset, const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat) {
+    KYGX_ASSERT(pack);
+
+    ReadbackInfo info;
+    if (!prepareRead(fb, x, y, width, height, pixelFormat, &info))
+        return true;
+
+    info.packOffset = offset;
+    info.packSize = info.dstStride * (info.dstOffsetY + info.clippedHeight);
+
+    // Pending reads into the same range must be written first, others are left alone.
+    ReadbackInfo** link = &pack->pendingReads;
+    while (*link) {
+        ReadbackInfo* cur = *link;
+        if ((cur->packOffset < (offset + info.packSize)) && (offset < (cur->packOffset + cur->packSize))) {
+            *link = cur->next;
+            resolvePackRead(pack, cur);
+        } else {
+            link = &cur->next;
         }
     }
 
-    glassLinearFree(tmpBuffer);
-}
\ No newline at end of file
+    ReadbackInfo* pending = (ReadbackInfo*)glassHeapAlloc(sizeof(ReadbackInfo));
+    if (!pending)
+        return false;
+
+    // Staging memory must outlive the scratch arena.
+    info.staging = glassLinearAlloc(info.stagingSize);
+    if (!info.staging) {
+        glassHeapFree(pending);
+        return false;
+    }
+
+    queueRead(&info);
+    *pending = info;
+    pending->next = pack->pendingReads;
+    pack->pendingReads = pending;
+    return true;
+}
+
+void GLASS_read_resolvePack(BufferInfo* pack) {
+    KYGX_ASSERT(pack);
+
+    while (pack->pendingReads) {
+        ReadbackInfo* info = pack->pendingReads;
+        pack->pendingReads = info->next;
+        resolvePackRead(pack, info);
+    }
+}
+
+static void releaseLinear(GLvoid* data, GLsizeiptr size) {
+    (void)size;
+    glassLinearFree(data);
+}
+
+void GLASS_read_discardPack(BufferInfo* pack) {
+    KYGX_ASSERT(pack);
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    while (pack->pendingReads) {
+        ReadbackInfo* info = pack->pendingReads;
+        pack->pendingReads = info->next;
+
+        // The GPU might still be writing the staging memory.
+        GLASS_bufferPool_releaseExternal(ctx, info->staging, info->stagingSize, info->fence, releaseLinear);
+        glassHeapFree(info);
+    }
+}
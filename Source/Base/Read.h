@@ -7,8 +7,38 @@
 #ifndef _GLASS_BASE_READ_H
 #define _GLASS_BASE_READ_H
 
+#include <KYGX/Wrappers/TextureCopy.h>
+#include <RIP/Pixels.h>
+
 #include "Base/Context.h"
 
-void GLASS_read_colorBuffer(const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat, u8* out);
+struct ReadbackInfo {
+    u8* cbAddr;                   // Color buffer address.
+    u16 cbWidth;                  // Color buffer width, as laid out by the GPU.
+    u16 cbHeight;                 // Color buffer height, as laid out by the GPU.
+    RIPPixelFormat cbPixelFormat; // Color buffer format.
+    RIPPixelFormat pixelFormat;   // Output format.
+    KYGXTextureCopyRect tiles;    // Tiles covering the rect.
+    u16 x0;                       // Clipped rect X.
+    u16 y0;                       // Clipped rect Y.
+    size_t clippedWidth;          // Clipped rect width.
+    size_t clippedHeight;         // Clipped rect height.
+    size_t dstOffsetX;            // Output X of the clipped rect.
+    size_t dstOffsetY;            // Output Y of the clipped rect.
+    size_t dstStride;             // Output row size.
+    u8* staging;                  // Tiles read back by the GPU.
+    size_t stagingSize;           // Staging memory size.
+    u32 fence;                    // Fence of the GPU transfer.
+    bool transferred;             // Whether the GPU also untiled and converted the tiles.
+    size_t packOffset;            // Pack buffer offset of the output.
+    size_t packSize;              // Pack buffer bytes written by the read.
+    struct ReadbackInfo* next;    // Next pending read of the same pack buffer.
+};
+
+bool GLASS_read_colorBuffer(const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat, u8* out);
+
+bool GLASS_read_queuePack(BufferInfo* pack, size_t offset, const FramebufferInfo* fb, GLint x, GLint y, size_t width, size_t height, RIPPixelFormat pixelFormat);
+void GLASS_read_resolvePack(BufferInfo* pack);
+void GLASS_read_discardPack(BufferInfo* pack);
 
 #endif /* _GLASS_READ_H */
\ No newline at end of file
@@ -0,0 +1,353 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Base/Residency.h"
+#include "Base/MemStats.h"
+#include "Base/TexManager.h"
+#include "Base/VRAM.h"
+
+#include <string.h> // memcpy
+
+// Max bytes moved between linear memory and VRAM on each update.
+#define GLASS_RESIDENCY_MAX_MOVE_SIZE 0x80000
+
+typedef struct {
+    TextureInfo* tex; // Managed texture.
+    size_t size;      // Size of texture data.
+    bool hot;         // Whether the texture fits in the budget.
+} ResidencyEntry;
+
+static ResidencyEntry* g_Entries = NULL;
+static size_t g_NumEntries = 0;
+static size_t g_EntriesCapacity = 0;
+
+// Objects waiting for a VRAM bank move.
+static GLuint* g_Pending = NULL;
+static size_t g_NumPending = 0;
+static size_t g_PendingCapacity = 0;
+
+static bool addEntry(TextureInfo* tex) {
+    if (g_NumEntries == g_EntriesCapacity) {
+        const size_t newCapacity = g_EntriesCapacity ? (g_EntriesCapacity << 1) : 32;
+        ResidencyEntry* entries = (ResidencyEntry*)glassHeapAlloc(newCapacity * sizeof(ResidencyEntry));
+        if (!entries)
+            return false;
+
+        if (g_Entries) {
+            memcpy(entries, g_Entries, g_NumEntries * sizeof(ResidencyEntry));
+            glassHeapFree(g_Entries);
+        }
+
+        g_Entries = entries;
+        g_EntriesCapacity = newCapacity;
+    }
+
+    ResidencyEntry* e = &g_Entries[g_NumEntries++];
+    e->tex = tex;
+    e->size = 0;
+    e->hot = false;
+    return true;
+}
+
+static bool addPending(GLuint obj) {
+    if (g_NumPending == g_PendingCapacity) {
+        const size_t newCapacity = g_PendingCapacity ? (g_PendingCapacity << 1) : 16;
+        GLuint* pending = (GLuint*)glassHeapAlloc(newCapacity * sizeof(GLuint));
+        if (!pending)
+            return false;
+
+        if (g_Pending) {
+            memcpy(pending, g_Pending, g_NumPending * sizeof(GLuint));
+            glassHeapFree(g_Pending);
+        }
+
+        g_Pending = pending;
+        g_PendingCapacity = newCapacity;
+    }
+
+    g_Pending[g_NumPending++] = obj;
+    return true;
+}
+
+static void removeEntry(size_t index) {
+    KYGX_ASSERT(index < g_NumEntries);
+
+    g_Entries[index].tex->managed = false;
+    g_Entries[index] = g_Entries[--g_NumEntries];
+}
+
+void GLASS_residency_noteDraw(CtxCommon* ctx, size_t numVertices) {
+    KYGX_ASSERT(ctx);
+
+    if (!ctx->params.textureVRAMBudget)
+        return;
+
+    for (size_t i = 0; i < GLASS_NUM_TEX_UNITS; ++i) {
+        TextureInfo* tex = (TextureInfo*)ctx->textureUnits[i];
+        if (!tex || tex->manualVRAM || tex->transient)
+            continue;
+
+        if (!tex->managed) {
+            if (!addEntry(tex))
+                continue;
+
+            tex->managed = true;
+        }
+
+        // Vertices drawn are a rough estimate of the sampled area.
+        const u32 uses = tex->uses + numVertices;
+        tex->uses = (uses < tex->uses) ? UINT32_MAX : uses;
+    }
+}
+
+void GLASS_residency_forget(TextureInfo* tex) {
+    KYGX_ASSERT(tex);
+
+    if (!tex->managed)
+        return;
+
+    for (size_t i = 0; i < g_NumEntries; ++i) {
+        if (g_Entries[i].tex == tex) {
+            removeEntry(i);
+            return;
+        }
+    }
+}
+
+static u8* getAttachmentAddress(GLuint attachment, size_t face) {
+    if (GLASS_OBJ_IS_RENDERBUFFER(attachment))
+        return ((RenderbufferInfo*)attachment)->address;
+
+    if (GLASS_OBJ_IS_TEXTURE(attachment))
+        return ((TextureInfo*)attachment)->faces[face];
+
+    return NULL;
+}
+
+// Bank shared by color and depth buffers, or KYGX_ALLOC_VRAM_BANK_ANY if none.
+static KYGXVRAMBank getSharedBank(const FramebufferInfo* fb) {
+    const u8* color = getAttachmentAddress(fb->colorBuffer, fb->texFace);
+    const u8* depth = getAttachmentAddress(fb->depthBuffer, 0);
+
+    if (!color || !depth || !glassIsVRAM(color) || !glassIsVRAM(depth))
+        return KYGX_ALLOC_VRAM_BANK_ANY;
+
+    const KYGXVRAMBank bank = GLASS_vram_getBank(color);
+    return (bank == GLASS_vram_getBank(depth)) ? bank : KYGX_ALLOC_VRAM_BANK_ANY;
+}
+
+void GLASS_residency_balanceBanks(FramebufferInfo* fb, bool depthChanged) {
+    KYGX_ASSERT(fb);
+
+    fb->balanceDepth = depthChanged;
+
+    // Moving data requires the GPU to be idle, wait for the end of the frame.
+    if (fb->unbalanced || (getSharedBank(fb) == KYGX_ALLOC_VRAM_BANK_ANY))
+        return;
+
+    fb->unbalanced = addPending((GLuint)fb);
+}
+
+bool GLASS_residency_queueBankMove(GLuint obj) {
+    KYGX_ASSERT(GLASS_OBJ_IS_TEXTURE(obj) || GLASS_OBJ_IS_RENDERBUFFER(obj));
+
+    bool* pending = GLASS_OBJ_IS_TEXTURE(obj) ? &((TextureInfo*)obj)->bankPending : &((RenderbufferInfo*)obj)->bankPending;
+    if (!*pending)
+        *pending = addPending(obj);
+
+    return *pending;
+}
+
+static bool moveAttachment(CtxCommon* ctx, GLuint attachment, KYGXVRAMBank bank) {
+    if (GLASS_OBJ_IS_RENDERBUFFER(attachment)) {
+        RenderbufferInfo* info = (RenderbufferInfo*)attachment;
+        if ((info->vramBank != GL_NONE) || info->transient)
+            return false;
+
+        u8* address = GLASS_vram_move(info->address, bank);
+        if (!address)
+            return false;
+
+        GLASS_memStats_move(GLASS_MEMORY_RENDERBUFFERS, info->address, address, glassVRAMSize(address));
+        info->address = address;
+        return true;
+    }
+
+    if (GLASS_OBJ_IS_TEXTURE(attachment)) {
+        TextureInfo* tex = (TextureInfo*)attachment;
+        if ((tex->vramBank != GL_NONE) || !tex->vram || tex->transient)
+            return false;
+
+        if (!GLASS_tex_move(tex, true, bank))
+            return false;
+
+        ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
+        return true;
+    }
+
+    return false;
+}
+
+// Color and depth buffers in the same bank compete for bandwidth, move one of them to the other bank.
+static void balanceFramebuffer(CtxCommon* ctx, FramebufferInfo* fb) {
+    if (!fb->unbalanced)
+        return;
+
+    fb->unbalanced = false;
+
+    const KYGXVRAMBank bank = getSharedBank(fb);
+    if (bank == KYGX_ALLOC_VRAM_BANK_ANY)
+        return;
+
+    // Prefer moving the buffer that was attached last.
+    const GLuint first = fb->balanceDepth ? fb->depthBuffer : fb->colorBuffer;
+    const GLuint second = fb->balanceDepth ? fb->colorBuffer : fb->depthBuffer;
+
+    const KYGXVRAMBank newBank = GLASS_vram_getOppositeBank(bank);
+    if (moveAttachment(ctx, first, newBank) || moveAttachment(ctx, second, newBank))
+        ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
+}
+
+static void moveTextureToPinnedBank(CtxCommon* ctx, TextureInfo* tex) {
+    if (!tex->bankPending)
+        return;
+
+    tex->bankPending = false;
+
+    // Transient storage picks the bank on the next allocation.
+    if ((tex->vramBank == GL_NONE) || !tex->vram || !tex->faces[0] || tex->transient)
+        return;
+
+    const KYGXVRAMBank newBank = GLASS_vram_unwrapBank(tex->vramBank);
+    if ((GLASS_vram_getBank(tex->faces[0]) != newBank) && GLASS_tex_move(tex, true, newBank))
+        ctx->flags |= (GLASS_CONTEXT_FLAG_TEXTURE | GLASS_CONTEXT_FLAG_FRAMEBUFFER);
+}
+
+static void moveRenderbufferToPinnedBank(CtxCommon* ctx, RenderbufferInfo* info) {
+    if (!info->bankPending)
+        return;
+
+    info->bankPending = false;
+
+    if ((info->vramBank == GL_NONE) || !info->address || info->transient)
+        return;
+
+    const KYGXVRAMBank newBank = GLASS_vram_unwrapBank(info->vramBank);
+    if (glassIsVRAM(info->address) && (GLASS_vram_getBank(info->address) == newBank))
+        return;
+
+    u8* address = GLASS_vram_move(info->address, newBank);
+    if (!address)
+        return;
+
+    GLASS_memStats_move(GLASS_MEMORY_RENDERBUFFERS, info->address, address, glassVRAMSize(address));
+    info->address = address;
+    ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
+}
+
+static void movePending(CtxCommon* ctx) {
+    // Objects might have been deleted in the meantime.
+    for (size_t i = 0; i < g_NumPending; ++i) {
+        const GLuint obj = g_Pending[i];
+
+        if (GLASS_OBJ_IS_FRAMEBUFFER(obj)) {
+            balanceFramebuffer(ctx, (FramebufferInfo*)obj);
+        } else if (GLASS_OBJ_IS_TEXTURE(obj)) {
+            moveTextureToPinnedBank(ctx, (TextureInfo*)obj);
+        } else if (GLASS_OBJ_IS_RENDERBUFFER(obj)) {
+            moveRenderbufferToPinnedBank(ctx, (RenderbufferInfo*)obj);
+        }
+    }
+
+    g_NumPending = 0;
+}
+
+// Heat per byte, hottest first.
+static inline bool isHotter(const ResidencyEntry* a, const ResidencyEntry* b) {
+    return ((u64)a->tex->heat * b->size) > ((u64)b->tex->heat * a->size);
+}
+
+void GLASS_residency_update(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+
+    // Handle bank moves queued during the frame.
+    movePending(ctx);
+
+    const size_t budget = ctx->params.textureVRAMBudget;
+    if (!budget || !g_NumEntries)
+        return;
+
+    // Update heat, drop textures placed by the application.
+    for (size_t i = 0; i < g_NumEntries;) {
+        ResidencyEntry* e = &g_Entries[i];
+        TextureInfo* tex = e->tex;
+
+        if (tex->manualVRAM) {
+            removeEntry(i);
+            continue;
+        }
+
+        tex->heat = (tex->heat - (tex->heat >> 2)) + tex->uses;
+        tex->uses = 0;
+        e->size = GLASS_tex_getDataSize(tex);
+        ++i;
+    }
+
+    // Sort by heat.
+    for (size_t i = 1; i < g_NumEntries; ++i) {
+        const ResidencyEntry e = g_Entries[i];
+
+        size_t j = i;
+        for (; (j > 0) && isHotter(&e, &g_Entries[j - 1]); --j)
+            g_Entries[j] = g_Entries[j - 1];
+
+        g_Entries[j] = e;
+    }
+
+    // Pick the textures that should live in VRAM.
+    size_t hotSize = 0;
+    for (size_t i = 0; i < g_NumEntries; ++i) {
+        ResidencyEntry* e = &g_Entries[i];
+        e->hot = e->size && e->tex->heat && ((hotSize + e->size) <= budget);
+
+        if (e->hot)
+            hotSize += e->size;
+    }
+
+    // The GPU is idle, data can be moved right away.
+    size_t movedSize = 0;
+    size_t residentSize = 0;
+
+    // Demote cold textures first, to make room for hot ones.
+    for (size_t i = g_NumEntries; i > 0; --i) {
+        ResidencyEntry* e = &g_Entries[i - 1];
+        if (!e->tex->vram || !e->size)
+            continue;
+
+        if (!e->hot && ((movedSize + e->size) <= GLASS_RESIDENCY_MAX_MOVE_SIZE) && GLASS_tex_move(e->tex, false, KYGX_ALLOC_VRAM_BANK_ANY)) {
+            movedSize += e->size;
+        } else {
+            residentSize += e->size;
+        }
+    }
+
+    for (size_t i = 0; i < g_NumEntries; ++i) {
+        ResidencyEntry* e = &g_Entries[i];
+        if (!e->hot || e->tex->vram)
+            continue;
+
+        if (((residentSize + e->size) > budget) || ((movedSize + e->size) > GLASS_RESIDENCY_MAX_MOVE_SIZE))
+            break;
+
+        if (GLASS_tex_move(e->tex, true, GLASS_vram_unwrapBank(e->tex->vramBank))) {
+            movedSize += e->size;
+            residentSize += e->size;
+        }
+    }
+
+    if (movedSize)
+        ctx->flags |= (GLASS_CONTEXT_FLAG_TEXTURE | GLASS_CONTEXT_FLAG_FRAMEBUFFER);
+}
@@ -0,0 +1,18 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_RESIDENCY_H
+#define _GLASS_BASE_RESIDENCY_H
+
+#include "Base/Context.h"
+
+void GLASS_residency_noteDraw(CtxCommon* ctx, size_t numVertices);
+void GLASS_residency_forget(TextureInfo* tex);
+void GLASS_residency_balanceBanks(FramebufferInfo* fb, bool depthChanged);
+bool GLASS_residency_queueBankMove(GLuint obj);
+void GLASS_residency_update(CtxCommon* ctx);
+
+#endif /* _GLASS_BASE_RESIDENCY_H */
@@ -0,0 +1,112 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Temporary linear buffers are bump allocated from a per-context
+ * arena. The whole arena is reset once nothing is live and the
+ * fence of the last GPU work that used it has completed. Requests
+ * that don't fit fall back to glassLinearAlloc.
+ */
+#include <KYGX/Utility.h>
+
+#include "Base/BufferPool.h"
+#include "Base/MemStats.h"
+#include "Base/Scratch.h"
+
+#include <string.h> // memset
+
+// Allocations are cache line aligned, so that flushing or invalidating one doesn't affect others.
+#define SCRATCH_ALIGNMENT 32
+
+void GLASS_scratch_init(ScratchArena* arena, size_t capacity) {
+    KYGX_ASSERT(arena);
+
+    memset(arena, 0, sizeof(ScratchArena));
+    arena->capacity = kygxAlignDown(capacity, SCRATCH_ALIGNMENT);
+}
+
+void GLASS_scratch_destroy(ScratchArena* arena) {
+    KYGX_ASSERT(arena);
+    KYGX_ASSERT(!arena->numLive);
+
+    GLASS_memStats_remove(GLASS_MEMORY_SCRATCH, arena->base, arena->capacity);
+    glassLinearFree(arena->base);
+    memset(arena, 0, sizeof(ScratchArena));
+}
+
+static inline bool isArenaMemory(const ScratchArena* arena, const void* p) {
+    KYGX_ASSERT(arena);
+    return arena->base && ((const u8*)p >= arena->base) && ((const u8*)p < (arena->base + arena->capacity));
+}
+
+static u8* allocFallback(size_t size) {
+    u8* p = glassLinearAlloc(size);
+    if (p)
+        GLASS_memStats_add(GLASS_MEMORY_SCRATCH, p, glassLinearSize(p), GLASS_INVALID_OBJECT);
+
+    return p;
+}
+
+u8* GLASS_scratch_alloc(CtxCommon* ctx, size_t size) {
+    KYGX_ASSERT(ctx);
+
+    ScratchArena* arena = &ctx->scratch;
+    const size_t alignedSize = kygxAlignUp(size, SCRATCH_ALIGNMENT);
+
+    if (!alignedSize || (alignedSize > arena->capacity))
+        return allocFallback(size);
+
+    // Arena memory is only reserved when first needed.
+    if (!arena->base) {
+        arena->base = glassLinearAlloc(arena->capacity);
+        if (!arena->base)
+            return allocFallback(size);
+
+        GLASS_memStats_add(GLASS_MEMORY_SCRATCH, arena->base, arena->capacity, GLASS_INVALID_OBJECT);
+    }
+
+    // Start over if the GPU is done with the whole arena.
+    if (!arena->numLive && GLASS_context_isFenceDone(ctx, arena->fence))
+        arena->offset = 0;
+
+    if ((arena->capacity - arena->offset) < alignedSize)
+        return allocFallback(size);
+
+    u8* p = arena->base + arena->offset;
+    arena->offset += alignedSize;
+    ++arena->numLive;
+    return p;
+}
+
+static void releaseFallback(GLvoid* data, GLsizeiptr size) {
+    GLASS_memStats_remove(GLASS_MEMORY_SCRATCH, data, size);
+    glassLinearFree(data);
+}
+
+void GLASS_scratch_release(CtxCommon* ctx, void* p, u32 fence) {
+    KYGX_ASSERT(ctx);
+
+    if (!p)
+        return;
+
+    ScratchArena* arena = &ctx->scratch;
+    if (!isArenaMemory(arena, p)) {
+        // Fallback allocations are freed once the GPU is done with them, without waiting.
+        GLASS_bufferPool_releaseExternal(ctx, p, glassLinearSize(p), fence, releaseFallback);
+        return;
+    }
+
+    KYGX_ASSERT(arena->numLive);
+    --arena->numLive;
+
+    // Keep the latest fence.
+    if ((s32)(fence - arena->fence) > 0)
+        arena->fence = fence;
+
+    // Reset if no GPU work needs the arena anymore.
+    if (!arena->numLive && GLASS_context_isFenceDone(ctx, arena->fence))
+        arena->offset = 0;
+}
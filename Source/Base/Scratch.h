@@ -0,0 +1,24 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_SCRATCH_H
+#define _GLASS_BASE_SCRATCH_H
+
+#include "Base/Context.h"
+
+void GLASS_scratch_init(ScratchArena* arena, size_t capacity);
+void GLASS_scratch_destroy(ScratchArena* arena);
+
+u8* GLASS_scratch_alloc(CtxCommon* ctx, size_t size);
+void GLASS_scratch_release(CtxCommon* ctx, void* p, u32 fence);
+
+// Release memory that is not used by pending GPU commands.
+static inline void GLASS_scratch_free(CtxCommon* ctx, void* p) {
+    KYGX_ASSERT(ctx);
+    GLASS_scratch_release(ctx, p, ctx->completedFence);
+}
+
+#endif /* _GLASS_BASE_SCRATCH_H */
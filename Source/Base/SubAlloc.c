@@ -0,0 +1,220 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Small linear allocations are carved out of slabs, each serving a
+ * single power-of-two size class. Every chunk is preceded by a small
+ * header pointing to its slab, so that freeing doesn't have to look
+ * for it; data stays aligned to 16 bytes, which satisfies both
+ * attribute data and GX copies. Free chunks are linked through their
+ * own memory. Slabs are sized per class, and those with free chunks
+ * are kept at the front of their class list.
+ *
+ * Bigger allocations go straight to glassLinearAlloc.
+ */
+#include "Base/SubAlloc.h"
+#include "Base/Math.h"
+
+#include <string.h> // memset
+
+#define MIN_CHUNK_SHIFT 4
+#define NUM_CLASSES 9
+#define MIN_CHUNK_SIZE (1u << MIN_CHUNK_SHIFT)
+#define MAX_CHUNK_SIZE (1u << (MIN_CHUNK_SHIFT + NUM_CLASSES - 1))
+#define HEADER_SIZE 16
+#define MAX_SLAB_SIZE 0x2000
+#define MIN_SLAB_CHUNKS 2
+#define MAX_SLAB_CHUNKS 64
+
+typedef struct Slab {
+    struct Slab* prev; // Previous slab in the same class.
+    struct Slab* next; // Next slab in the same class.
+    u8* base;          // Slab memory.
+    void* freeList;    // First free chunk.
+    u16 numChunks;     // Num of chunks.
+    u16 numFree;       // Num of free chunks.
+    u8 index;          // Size class.
+} Slab;
+
+typedef struct {
+    Slab* head; // Slabs with free chunks come first.
+    Slab* tail; // Full slabs are moved last.
+} SlabList;
+
+static SlabList g_Slabs[NUM_CLASSES];
+
+static inline size_t getClass(size_t size) {
+    size_t index = 0;
+
+    while ((MIN_CHUNK_SIZE << index) < size)
+        ++index;
+
+    return index;
+}
+
+static inline size_t getChunkSize(size_t index) { return MIN_CHUNK_SIZE << index; }
+
+// Distance between chunks, header included.
+static inline size_t getChunkStride(size_t index) { return HEADER_SIZE + getChunkSize(index); }
+
+// Small classes get many chunks per slab, big ones only a few, so that the first allocation doesn't reserve too much.
+static inline size_t getNumSlabChunks(size_t index) {
+    return GLASS_CLAMP(MIN_SLAB_CHUNKS, MAX_SLAB_CHUNKS, MAX_SLAB_SIZE / getChunkStride(index));
+}
+
+static inline Slab* getChunkSlab(const void* p) { return *(Slab**)((u8*)p - HEADER_SIZE); }
+
+static void unlinkSlab(SlabList* list, Slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        list->head = slab->next;
+    }
+
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    } else {
+        list->tail = slab->prev;
+    }
+}
+
+static void pushFront(SlabList* list, Slab* slab) {
+    slab->prev = NULL;
+    slab->next = list->head;
+
+    if (list->head) {
+        list->head->prev = slab;
+    } else {
+        list->tail = slab;
+    }
+
+    list->head = slab;
+}
+
+static void pushBack(SlabList* list, Slab* slab) {
+    slab->prev = list->tail;
+    slab->next = NULL;
+
+    if (list->tail) {
+        list->tail->next = slab;
+    } else {
+        list->head = slab;
+    }
+
+    list->tail = slab;
+}
+
+static Slab* allocSlab(size_t index) {
+    Slab* slab = (Slab*)glassHeapAlloc(sizeof(Slab));
+    if (!slab)
+        return NULL;
+
+    const size_t stride = getChunkStride(index);
+    slab->numChunks = getNumSlabChunks(index);
+    slab->base = glassLinearAlloc(slab->numChunks * stride);
+    if (!slab->base) {
+        glassHeapFree(slab);
+        return NULL;
+    }
+
+    // Write headers and link all chunks.
+    slab->numFree = slab->numChunks;
+    slab->freeList = NULL;
+    slab->index = index;
+
+    for (size_t i = slab->numChunks; i > 0; --i) {
+        u8* header = slab->base + ((i - 1) * stride);
+        *(Slab**)header = slab;
+
+        void** chunk = (void**)(header + HEADER_SIZE);
+        *chunk = slab->freeList;
+        slab->freeList = chunk;
+    }
+
+    pushFront(&g_Slabs[index], slab);
+    return slab;
+}
+
+u8* GLASS_subAlloc_alloc(size_t size) {
+    if (!size || (size > MAX_CHUNK_SIZE))
+        return glassLinearAlloc(size);
+
+    const size_t index = getClass(size);
+    SlabList* list = &g_Slabs[index];
+
+    Slab* slab = list->head;
+    if (!slab || !slab->numFree) {
+        slab = allocSlab(index);
+        if (!slab)
+            return NULL;
+    }
+
+    void** chunk = (void**)slab->freeList;
+    slab->freeList = *chunk;
+
+    // Keep full slabs out of the way.
+    if (!--slab->numFree && (slab != list->tail)) {
+        unlinkSlab(list, slab);
+        pushBack(list, slab);
+    }
+
+    return (u8*)chunk;
+}
+
+void GLASS_subAlloc_free(void* p, size_t size) {
+    if (!p)
+        return;
+
+    if (!size || (size > MAX_CHUNK_SIZE)) {
+        glassLinearFree(p);
+        return;
+    }
+
+    Slab* slab = getChunkSlab(p);
+    KYGX_ASSERT(slab->index == getClass(size));
+    KYGX_ASSERT((((u8*)p - HEADER_SIZE - slab->base) % getChunkStride(slab->index)) == 0);
+
+    SlabList* list = &g_Slabs[slab->index];
+
+    void** chunk = (void**)p;
+    *chunk = slab->freeList;
+    slab->freeList = chunk;
+
+    // The slab has free chunks again.
+    if ((++slab->numFree == 1) && (slab != list->head)) {
+        unlinkSlab(list, slab);
+        pushFront(list, slab);
+    }
+
+    // Release empty slabs, but keep the last one of each class around.
+    if ((slab->numFree == slab->numChunks) && (list->head != list->tail)) {
+        unlinkSlab(list, slab);
+        glassLinearFree(slab->base);
+        glassHeapFree(slab);
+    }
+}
+
+void GLASS_subAlloc_getStats(GLASSSubAllocStats* stats) {
+    KYGX_ASSERT(stats);
+
+    memset(stats, 0, sizeof(GLASSSubAllocStats));
+
+    for (size_t i = 0; i < NUM_CLASSES; ++i) {
+        const size_t chunkSize = getChunkSize(i);
+
+        for (const Slab* slab = g_Slabs[i].head; slab; slab = slab->next) {
+            const size_t usedBytes = (slab->numChunks - slab->numFree) * chunkSize;
+
+            ++stats->numSlabs;
+            stats->reservedBytes += slab->numChunks * getChunkStride(i);
+            stats->usedBytes += usedBytes;
+            stats->largestFreeChunk = GLASS_MAX(stats->largestFreeChunk, slab->numFree ? chunkSize : 0);
+
+            if (!usedBytes)
+                ++stats->numEmptySlabs;
+        }
+    }
+}
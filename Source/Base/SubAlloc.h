@@ -0,0 +1,17 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_SUBALLOC_H
+#define _GLASS_BASE_SUBALLOC_H
+
+#include "Base/Types.h"
+
+u8* GLASS_subAlloc_alloc(size_t size);
+void GLASS_subAlloc_free(void* p, size_t size);
+
+void GLASS_subAlloc_getStats(GLASSSubAllocStats* stats);
+
+#endif /* _GLASS_BASE_SUBALLOC_H */
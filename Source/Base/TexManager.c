@@ -4,14 +4,21 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <KYGX/Wrappers/DisplayTransfer.h>
 #include <KYGX/Wrappers/TextureCopy.h>
 #include <KYGX/Wrappers/FlushCacheRegions.h>
 #include <KYGX/Utility.h>
 #include <RIP/Texture.h>
 #include <RIP/Convert.h>
 
+#include "Base/Budget.h"
 #include "Base/Context.h"
+#include "Base/ETC.h"
+#include "Base/MemStats.h"
+#include "Base/Scratch.h"
 #include "Base/TexManager.h"
+#include "Base/Transient.h"
+#include "Base/VRAM.h"
 
 #include <string.h> // memset
 
@@ -94,6 +101,46 @@ void GLASS_tex_getAsRenderbuffer(const TextureInfo* tex, size_t face, Renderbuff
     out->bound = false;
 }
 
+static void freeFace(u8* p, bool vram) {
+    if (!p)
+        return;
+
+    if (vram) {
+        GLASS_vram_free(p);
+    } else {
+        GLASS_budget_removeLinearUsage(glassLinearSize(p));
+        glassLinearFree(p);
+    }
+}
+
+static inline size_t getFaceSize(const u8* p) { return glassIsVRAM(p) ? glassVRAMSize(p) : glassLinearSize(p); }
+
+static void freeTexFace(TextureInfo* tex, size_t face) {
+    u8* p = tex->faces[face];
+
+    // Don't let a queued upload write into freed memory.
+    if (p) {
+        CtxCommon* ctx = GLASS_context_getBound();
+        if (!GLASS_context_isFenceDone(ctx, tex->uploadFence))
+            GLASS_context_waitFence(ctx, tex->uploadFence);
+    }
+
+    // Transient storage is owned by the pool.
+    if (tex->transient && face == 0) {
+        GLASS_transient_release(tex->transientPool, p);
+        tex->transientPool = NULL;
+        return;
+    }
+
+    if (p) {
+        const size_t size = getFaceSize(p);
+        GLASS_memStats_remove(GLASS_MEMORY_TEXTURES, p, size);
+        GLASS_memStats_removeTexFormat(tex->format, size);
+    }
+
+    freeFace(p, tex->vram);
+}
+
 void GLASS_tex_setParams(TextureInfo* tex, size_t width, size_t height, GPUTexFormat format, bool vram, u8** faces) {
     KYGX_ASSERT(tex);
     KYGX_ASSERT(faces);
@@ -103,15 +150,73 @@ void GLASS_tex_setParams(TextureInfo* tex, size_t width, size_t height, GPUTexFo
 
     const size_t numFaces = getNumFaces(tex->target);
     for (size_t i = 0; i < numFaces; ++i) {
-        u8* p = tex->faces[i];
-        tex->vram ? glassVRAMFree(p) : glassLinearFree(p);
+        freeTexFace(tex, i);
         tex->faces[i] = faces[i];
+
+        if (!faces[i] || tex->transient)
+            continue;
+
+        if (!vram)
+            GLASS_budget_addLinearUsage(glassLinearSize(faces[i]));
+
+        const size_t size = getFaceSize(faces[i]);
+        GLASS_memStats_add(GLASS_MEMORY_TEXTURES, faces[i], size, (GLuint)tex);
+        GLASS_memStats_addTexFormat(format, size);
     }
 
     tex->format = format;
     tex->width = width;
     tex->height = height;
     tex->vram = vram;
+    GLASS_invalidateFramebuffers();
+
+    // Keep track of VRAM textures for compaction.
+    if (vram && faces[0] && !tex->transient) {
+        GLASS_vram_track((GLuint)tex);
+    } else {
+        GLASS_vram_untrack((GLuint)tex);
+    }
+}
+
+void GLASS_tex_freeData(TextureInfo* tex) {
+    KYGX_ASSERT(tex);
+
+    for (size_t i = 0; i < GLASS_NUM_TEX_FACES; ++i) {
+        freeTexFace(tex, i);
+        tex->faces[i] = NULL;
+    }
+
+    // Force reallocation on the next upload.
+    tex->width = 0;
+    tex->height = 0;
+    GLASS_vram_untrack((GLuint)tex);
+    GLASS_invalidateFramebuffers();
+}
+
+static bool allocFaces(GLenum target, size_t allocSize, bool vram, KYGXVRAMBank bank, u8** faces) {
+    const size_t numFaces = getNumFaces(target);
+
+    for (size_t i = 0; i < numFaces; ++i) {
+        faces[i] = vram ? GLASS_vram_alloc(allocSize, bank) : glassLinearAlloc(allocSize);
+
+        // Cube map faces must be close to each other.
+        const bool valid = faces[i] && (i == 0 || ripValidateTextureFaceAddr(faces[0], faces[i]));
+        if (!valid) {
+            // Free allocated buffers.
+            for (size_t j = 0; j <= i; ++j) {
+                u8* q = faces[j];
+                vram ? GLASS_vram_free(q) : glassLinearFree(q);
+                faces[j] = NULL;
+            }
+
+            return false;
+        }
+    }
+
+    if (numFaces > 1)
+        ripSortTextureFaces(faces);
+
+    return true;
 }
 
 static inline bool GLASS_reallocTexImpl(TextureInfo* tex, size_t width, size_t height, GPUTexFormat format, bool vram) {
@@ -121,27 +226,46 @@ static inline bool GLASS_reallocTexImpl(TextureInfo* tex, size_t width, size_t h
     memset(faces, 0, GLASS_NUM_TEX_FACES * sizeof(u8*));
 
     if (width && height) {
-        const size_t numFaces = getNumFaces(tex->target);
         const size_t allocSize = ripGetTextureDataSize(width, height, getRIPPixelFormat(format), ripGetNumTextureLevels(width, height));
-
-        for (size_t i = 0; i < numFaces; ++i) {
-            faces[i] = vram ? glassVRAMAlloc(allocSize, KYGX_ALLOC_VRAM_BANK_ANY) : glassLinearAlloc(allocSize);
-
-            const bool valid = faces[i] && (i == 0 || ripValidateTextureFaceAddr(faces[0], faces[i]));
-            if (!valid) {
-                // Free allocated buffers.
-                for (size_t j = 0; j < i; ++j) {
-                    u8* q = faces[j];
-                    vram ? glassVRAMFree(q) : glassLinearFree(q);
-                }
-
+        const size_t totalSize = allocSize * getNumFaces(tex->target);
+        const KYGXVRAMBank bank = GLASS_vram_unwrapBank(tex->vramBank);
+        CtxCommon* ctx = GLASS_context_getBound();
+
+        // Transient textures are always in VRAM.
+        if (tex->transient) {
+            KYGX_ASSERT(tex->target == GL_TEXTURE_2D);
+
+            // Release the current block first, so that it can be reused.
+            GLASS_tex_freeData(tex);
+            faces[0] = GLASS_transient_acquire(ctx, (GLuint)tex, allocSize, bank);
+            if (!faces[0]) {
                 GLASS_context_setError(GL_OUT_OF_MEMORY);
                 return false;
             }
+
+            GLASS_tex_setParams(tex, width, height, format, true, faces);
+            return true;
+        }
+
+        // Purge other objects to stay within budget.
+        if (!GLASS_budget_reserve(ctx, vram, totalSize, (GLuint)tex)) {
+            GLASS_context_setError(GL_OUT_OF_MEMORY);
+            return false;
         }
 
-        if (numFaces > 1)
-            ripSortTextureFaces(faces);
+        // VRAM might be fragmented, compact it and retry.
+        bool allocated = allocFaces(tex->target, allocSize, vram, bank, faces);
+        if (!allocated && vram && GLASS_vram_compact())
+            allocated = allocFaces(tex->target, allocSize, vram, bank, faces);
+
+        // Last resort: purge other objects.
+        if (!allocated && GLASS_budget_purge(ctx, vram, totalSize, (GLuint)tex))
+            allocated = allocFaces(tex->target, allocSize, vram, bank, faces);
+
+        if (!allocated) {
+            GLASS_context_setError(GL_OUT_OF_MEMORY);
+            return false;
+        }
     }
 
     GLASS_tex_setParams(tex, width, height, format, vram, faces);
@@ -160,34 +284,140 @@ TexReallocStatus GLASS_tex_realloc(TextureInfo* tex, size_t width, size_t height
     return GLASS_reallocTexImpl(tex, width, height, format, vram) ? TEXREALLOCSTATUS_UPDATED : TEXREALLOCSTATUS_FAILED;
 }
 
-void GLASS_tex_write(TextureInfo* tex, const u8* data, size_t face, size_t level) {
+bool GLASS_tex_move(TextureInfo* tex, bool vram, KYGXVRAMBank bank) {
     KYGX_ASSERT(tex);
     KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
-    KYGX_ASSERT(glassIsLinear(data));
-    KYGX_ASSERT(face < getNumFaces(tex->target));
+    KYGX_ASSERT(!tex->transient);
 
-    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
-    const size_t mipmapOffset = ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
-    const size_t size = (tex->width * tex->height * ripGetPixelFormatBPP(pixelFormat)) >> 3;
+    if (!tex->faces[0]) {
+        tex->vram = vram;
+        return true;
+    }
+
+    const size_t numFaces = getNumFaces(tex->target);
+    const size_t allocSize = ripGetTextureDataSize(tex->width, tex->height, getRIPPixelFormat(tex->format), ripGetNumTextureLevels(tex->width, tex->height));
+
+    // Allocate all faces first.
+    u8* faces[GLASS_NUM_TEX_FACES];
+    memset(faces, 0, GLASS_NUM_TEX_FACES * sizeof(u8*));
+
+    if (!allocFaces(tex->target, allocSize, vram, bank, faces))
+        return false;
+
+    // Copy data.
+    for (size_t i = 0; i < numFaces; ++i) {
+        KYGXFlushCacheRegionsBuffer flushSrc;
+        flushSrc.addr = tex->faces[i];
+        flushSrc.size = allocSize;
+
+        KYGXFlushCacheRegionsBuffer flushDst;
+        flushDst.addr = faces[i];
+        flushDst.size = allocSize;
 
+        kygxSyncFlushCacheRegions(&flushSrc, &flushDst, NULL);
+        kygxSyncTextureCopy(tex->faces[i], faces[i], allocSize, 0, 0, 0, 0);
+
+        // Avoid possible prefetches.
+        kygxInvalidateDataCache(flushDst.addr, flushDst.size);
+    }
+
+    GLASS_tex_setParams(tex, tex->width, tex->height, tex->format, vram, faces);
+    return true;
+}
+
+size_t GLASS_tex_getDataSize(const TextureInfo* tex) {
+    KYGX_ASSERT(tex);
+
+    if (!tex->faces[0])
+        return 0;
+
+    const size_t faceSize = ripGetTextureDataSize(tex->width, tex->height, getRIPPixelFormat(tex->format), ripGetNumTextureLevels(tex->width, tex->height));
+    return faceSize * getNumFaces(tex->target);
+}
+
+// Start queueing a copy into texture memory, optionally through an intermediate buffer.
+// numCmds is the number of GX commands the copy adds after the cache flush.
+static CtxCommon* beginWriteVia(const TextureInfo* tex, const u8* src, size_t srcSize, u8* tmp, size_t tmpSize, u8* dst, size_t dstSize, size_t numCmds) {
     // Ensure the hardware can access data correctly.
     KYGXFlushCacheRegionsBuffer flushSrc;
-    flushSrc.addr = data;
-    flushSrc.size = size;
+    flushSrc.addr = src;
+    flushSrc.size = srcSize;
 
-    u8* dst = tex->faces[face] + mipmapOffset;
     KYGXFlushCacheRegionsBuffer flushDst;
     flushDst.addr = dst;
-    flushDst.size = size;
+    flushDst.size = dstSize;
 
-    kygxSyncFlushCacheRegions(&flushSrc, &flushDst, NULL);
-    kygxSyncTextureCopy(data, dst, size, 0, 0, 0, 0);
+    // Dirty lines of the intermediate buffer could be evicted over the GPU output.
+    KYGXFlushCacheRegionsBuffer flushTmp;
+    flushTmp.addr = tmp;
+    flushTmp.size = tmpSize;
 
-    // Avoid possible prefetches.
-    kygxInvalidateDataCache(flushDst.addr, flushDst.size);
+    // Draws recorded so far must still see the old contents, send them only if they use the texture.
+    CtxCommon* ctx = GLASS_context_getBound();
+    if (GLASS_context_isFencePending(ctx, tex->fence))
+        GLASS_context_flush(ctx, true);
+
+    GLASS_context_reserveTransfer(ctx, numCmds + 1);
+
+    kygxLock();
+    kygxAddFlushCacheRegions(&ctx->GXCmdBuf, &flushSrc, &flushDst, tmp ? &flushTmp : NULL);
+    return ctx;
+}
+
+static inline CtxCommon* beginWrite(const TextureInfo* tex, const u8* src, size_t srcSize, u8* dst, size_t dstSize, size_t numCmds) {
+    return beginWriteVia(tex, src, srcSize, NULL, 0, dst, dstSize, numCmds);
+}
+
+// GX commands run in order, so the copy completes before any later draw.
+// The batch is left open, and gets finalized with the next submit.
+static void endWrite(CtxCommon* ctx, TextureInfo* tex) {
+    tex->uploadFence = GLASS_context_getPendingFence(ctx);
+    kygxUnlock(true);
+}
+
+static void queueWrite(TextureInfo* tex, const u8* data, u8* dst, size_t size) {
+    CtxCommon* ctx = beginWrite(tex, data, size, dst, size, 1);
+    kygxAddTextureCopy(&ctx->GXCmdBuf, data, dst, size, 0, 0, 0, 0);
+    endWrite(ctx, tex);
+}
+
+void GLASS_tex_write(TextureInfo* tex, const u8* data, size_t face, size_t level) {
+    KYGX_ASSERT(tex);
+    KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
+    KYGX_ASSERT(glassIsLinear(data));
+    KYGX_ASSERT(face < getNumFaces(tex->target));
+
+    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
+    const size_t mipmapOffset = ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
+    const size_t size = ((tex->width >> level) * (tex->height >> level) * ripGetPixelFormatBPP(pixelFormat)) >> 3;
+    queueWrite(tex, data, tex->faces[face] + mipmapOffset, size);
 }
 
-void GLASS_tex_writeUntiled(TextureInfo* tex, const u8* data, size_t face, size_t level) {
+void GLASS_tex_writeLevels(TextureInfo* tex, const u8* data, size_t face, size_t numLevels) {
+    KYGX_ASSERT(tex);
+    KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
+    KYGX_ASSERT(glassIsLinear(data));
+    KYGX_ASSERT(face < getNumFaces(tex->target));
+    KYGX_ASSERT(numLevels);
+
+    // Levels are stored back to back, so the whole chain is a single copy.
+    const size_t size = ripGetTextureDataSize(tex->width, tex->height, getRIPPixelFormat(tex->format), numLevels);
+    queueWrite(tex, data, tex->faces[face], size);
+}
+
+// Tile data, with a flip on the Y axis (opengl coords are inverted).
+// RGB(A) data with srcComponents set is compressed on the fly.
+static void convertToNative(const u8* src, u8* dst, size_t width, size_t height, GPUTexFormat format, size_t srcComponents) {
+    if (srcComponents) {
+        GLASS_etc_encode(src, dst, width, height, srcComponents, format == TEXFORMAT_ETC1A4);
+    } else if ((format == TEXFORMAT_ETC1) || (format == TEXFORMAT_ETC1A4)) {
+        GLASS_etc_toNative(src, dst, width, height, format == TEXFORMAT_ETC1A4);
+    } else {
+        ripConvertToNative(src, dst, width, height, getRIPPixelFormat(format), true);
+    }
+}
+
+static void writeLevel(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t srcComponents) {
     KYGX_ASSERT(tex);
     KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
     KYGX_ASSERT(data);
@@ -196,60 +426,242 @@ void GLASS_tex_writeUntiled(TextureInfo* tex, const u8* data, size_t face, size_
     const size_t height = tex->height >> level;
     const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
     const size_t size = (width * height * ripGetPixelFormatBPP(pixelFormat)) >> 3;
+    const size_t mipmapOffset = ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
+    u8* texData = tex->faces[face] + mipmapOffset;
 
-    const u8* src = data;
+    CtxCommon* ctx = GLASS_context_getBound();
 
-    // TODO: we could use the texture data if not in vram.
-    u8* dst = glassLinearAlloc(size);
+    // Tile straight into linear storage, as long as the GPU is done with it.
+    if (!glassIsVRAM(texData) && GLASS_context_isFenceDone(ctx, tex->fence) && GLASS_context_isFenceDone(ctx, tex->uploadFence)) {
+        convertToNative(data, texData, width, height, tex->format, srcComponents);
+        GLASS_context_markDirty(ctx, texData, size);
+        return;
+    }
+
+    u8* dst = GLASS_scratch_alloc(ctx, size);
     KYGX_ASSERT(dst);
 
-     // Allocate a temp buffer if data isn't in linearmem.
-    const bool isOriginLinear = glassIsLinear(data);
-   
-    if (!isOriginLinear) {
-        void* p = glassLinearAlloc(size);
-        KYGX_ASSERT(p);
-        memcpy(p, data, size);
-        src = p;
+    convertToNative(data, dst, width, height, tex->format, srcComponents);
+
+    // Write the converted data, the buffer is reused once the copy is done.
+    GLASS_tex_write(tex, dst, face, level);
+    GLASS_scratch_release(ctx, dst, tex->uploadFence);
+}
+
+void GLASS_tex_writeUntiled(TextureInfo* tex, const u8* data, size_t face, size_t level) { writeLevel(tex, data, face, level, 0); }
+
+void GLASS_tex_writeEncoded(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t srcComponents) {
+    KYGX_ASSERT((tex->format == TEXFORMAT_ETC1) || (tex->format == TEXFORMAT_ETC1A4));
+    KYGX_ASSERT((srcComponents == 3) || (srcComponents == 4));
+    writeLevel(tex, data, face, level, srcComponents);
+}
+
+static inline bool getTransferFormat(GPUTexFormat format, u8* out) {
+    switch (format) {
+        case TEXFORMAT_RGBA8:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGBA8;
+            return true;
+        case TEXFORMAT_RGB8:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB8;
+            return true;
+        case TEXFORMAT_RGB5A1:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB5A1;
+            return true;
+        case TEXFORMAT_RGB565:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB565;
+            return true;
+        case TEXFORMAT_RGBA4:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGBA4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Pack GL RGB(A) bytes into the untiled layout of a format with the same or fewer channels.
+static void packChannels(const u8* src, u8* dst, size_t numPixels, size_t srcComponents, GPUTexFormat format) {
+    for (size_t i = 0; i < numPixels; ++i) {
+        const u8* pixel = &src[i * srcComponents];
+        const u8 alpha = (srcComponents == 4) ? pixel[3] : 0xFF;
+
+        switch (format) {
+            case TEXFORMAT_RGBA8:
+                *dst++ = pixel[0];
+                *dst++ = pixel[1];
+                *dst++ = pixel[2];
+                *dst++ = alpha;
+                break;
+            case TEXFORMAT_RGB8:
+                *dst++ = pixel[0];
+                *dst++ = pixel[1];
+                *dst++ = pixel[2];
+                break;
+            case TEXFORMAT_LA8:
+                *dst++ = pixel[0];
+                *dst++ = alpha;
+                break;
+            case TEXFORMAT_L8:
+                *dst++ = pixel[0];
+                break;
+            case TEXFORMAT_A8:
+                *dst++ = alpha;
+                break;
+            default:
+                KYGX_UNREACHABLE("Invalid format!");
+        }
     }
+}
+
+// Tile the data at full precision, then let the display transfer engine reduce it.
+static void writeTransferred(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t srcComponents) {
+    const GPUTexFormat srcFormat = (srcComponents == 4) ? TEXFORMAT_RGBA8 : TEXFORMAT_RGB8;
+    const size_t width = tex->width >> level;
+    const size_t height = tex->height >> level;
+    const size_t srcSize = width * height * srcComponents;
+    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
+    const size_t dstSize = (width * height * ripGetPixelFormatBPP(pixelFormat)) >> 3;
+    u8* dst = tex->faces[face] + ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
 
-    // Do the conversion, with a flip on the Y axis (opengl coords are inverted).
-    ripConvertToNative(src, dst, width, height, pixelFormat, true);
+    KYGXDisplayTransferFlags transferFlags;
+    getTransferFormat(srcFormat, &transferFlags.srcFmt);
+    if (!getTransferFormat(tex->format, &transferFlags.dstFmt))
+        KYGX_UNREACHABLE("Invalid format!");
 
-    if (!isOriginLinear)
-        glassLinearFree((void*)src);
+    transferFlags.mode = KYGX_DISPLAYTRANSFER_MODE_T2T;
+    transferFlags.downscale = KYGX_DISPLAYTRANSFER_DOWNSCALE_NONE;
+    transferFlags.verticalFlip = false;
+    transferFlags.blockMode32 = false;
 
-    // Write the converted data.
-    GLASS_tex_write(tex, dst, face, level);
-    glassLinearFree(dst);
+    u8* tiled = GLASS_scratch_alloc(GLASS_context_getBound(), srcSize);
+    KYGX_ASSERT(tiled);
+
+    convertToNative(data, tiled, width, height, srcFormat, 0);
+
+    CtxCommon* ctx = beginWrite(tex, tiled, srcSize, dst, dstSize, 1);
+    kygxAddDisplayTransferChecked(&ctx->GXCmdBuf, tiled, dst, width, height, width, height, &transferFlags);
+    endWrite(ctx, tex);
+    GLASS_scratch_release(ctx, tiled, tex->uploadFence);
+}
+
+void GLASS_tex_writeConverted(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t srcComponents) {
+    KYGX_ASSERT(tex);
+    KYGX_ASSERT(data);
+    KYGX_ASSERT((srcComponents == 3) || (srcComponents == 4));
+
+    // 16-bit formats are converted by the GPU.
+    if ((tex->format == TEXFORMAT_RGBA4) || (tex->format == TEXFORMAT_RGB5A1) || (tex->format == TEXFORMAT_RGB565)) {
+        writeTransferred(tex, data, face, level, srcComponents);
+        return;
+    }
+
+    // Data is already in the right layout.
+    if (((tex->format == TEXFORMAT_RGBA8) && (srcComponents == 4)) || ((tex->format == TEXFORMAT_RGB8) && (srcComponents == 3))) {
+        writeLevel(tex, data, face, level, 0);
+        return;
+    }
+
+    const size_t numPixels = (tex->width >> level) * (tex->height >> level);
+    const size_t packedSize = (numPixels * ripGetPixelFormatBPP(getRIPPixelFormat(tex->format))) >> 3;
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    u8* packed = GLASS_scratch_alloc(ctx, packedSize);
+    KYGX_ASSERT(packed);
+
+    packChannels(data, packed, numPixels, srcComponents, tex->format);
+    writeLevel(tex, packed, face, level, 0);
+    GLASS_scratch_free(ctx, packed);
+}
+
+bool GLASS_tex_generateMipmaps(TextureInfo* tex) {
+    KYGX_ASSERT(tex);
+    KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
+    KYGX_ASSERT(tex->faces[0]);
+
+    KYGXDisplayTransferFlags transferFlags;
+    if (!getTransferFormat(tex->format, &transferFlags.srcFmt))
+        return false;
+
+    transferFlags.mode = KYGX_DISPLAYTRANSFER_MODE_T2T;
+    transferFlags.dstFmt = transferFlags.srcFmt;
+    transferFlags.downscale = KYGX_DISPLAYTRANSFER_DOWNSCALE_2X2;
+    transferFlags.verticalFlip = false;
+    transferFlags.blockMode32 = false;
+
+    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
+    const size_t numLevels = ripGetNumTextureLevels(tex->width, tex->height);
+    const size_t baseSize = ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, 1);
+    const size_t chainSize = ripGetTextureDataSize(tex->width, tex->height, pixelFormat, numLevels) - baseSize;
+    if (!chainSize)
+        return true;
+
+    for (size_t face = 0; face < getNumFaces(tex->target); ++face) {
+        u8* base = tex->faces[face];
+        // Faces are queued one by one, so that each of them fits in the command buffer.
+        CtxCommon* ctx = beginWrite(tex, base, baseSize, base + baseSize, chainSize, numLevels - 1);
+
+        // Each level is downscaled from the previous one, the transfers run in order.
+        for (size_t level = 1; level < numLevels; ++level) {
+            const size_t width = tex->width >> (level - 1);
+            const size_t height = tex->height >> (level - 1);
+            const u8* src = base + ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level - 1);
+            u8* dst = base + ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
+
+            // The output size is given before downscaling.
+            kygxAddDisplayTransferChecked(&ctx->GXCmdBuf, src, dst, width, height, width, height, &transferFlags);
+        }
+
+        endWrite(ctx, tex);
+    }
+
+    return true;
+}
+
+// Surface of a mipmap level.
+static void getLevelSurface(const TextureInfo* tex, size_t face, size_t level, KYGXTextureCopySurface* out) {
+    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
+    out->addr = tex->faces[face] + ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
+    out->width = tex->width >> level;
+    out->height = tex->height >> level;
+    out->pixelSize = ripGetPixelFormatBPP(pixelFormat) >> 3;
+    out->rotated = true;
 }
 
 void GLASS_tex_readRect(TextureInfo* tex, u8* dst, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height) {
     KYGX_ASSERT(tex);
     KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
-    KYGX_ASSERT(glassIsLinear(dst));    
+    KYGX_ASSERT(glassIsLinear(dst));
     KYGX_ASSERT(face < getNumFaces(tex->target));
     KYGX_ASSERT(kygxIsAligned(x, 8));
     KYGX_ASSERT(kygxIsAligned(y, 8));
     KYGX_ASSERT(kygxIsAligned(width, 8));
     KYGX_ASSERT(kygxIsAligned(height, 8));
 
-    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
-    const size_t bytesPerPixel = ripGetPixelFormatBPP(pixelFormat) >> 3;
-    const size_t mipmapOffset = ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
+    // Queued draws might render into the texture, wait for them and for queued uploads.
+    CtxCommon* ctx = GLASS_context_getBound();
+    GLASS_context_flush(ctx, true);
+    GLASS_context_waitFence(ctx, tex->fence);
+    GLASS_context_waitFence(ctx, tex->uploadFence);
 
     KYGXTextureCopySurface srcSurface;
-    srcSurface.addr = tex->faces[face] + mipmapOffset;
-    srcSurface.width = tex->width;
-    srcSurface.height = tex->height;
-    srcSurface.pixelSize = bytesPerPixel;
-    srcSurface.rotated = true;
+    getLevelSurface(tex, face, level, &srcSurface);
+
+    // Tiles written by the CPU might still be in the data cache.
+    const size_t rowSize = srcSurface.width * 8 * srcSurface.pixelSize;
+    const size_t dstSize = width * height * srcSurface.pixelSize;
+
+    KYGXFlushCacheRegionsBuffer flushSrc;
+    flushSrc.addr = (u8*)srcSurface.addr + ((y >> 3) * rowSize);
+    flushSrc.size = (height >> 3) * rowSize;
+
+    KYGXFlushCacheRegionsBuffer flushDst;
+    flushDst.addr = dst;
+    flushDst.size = dstSize;
 
     KYGXTextureCopySurface dstSurface;
     dstSurface.addr = dst;
     dstSurface.width = width;
     dstSurface.height = height;
-    dstSurface.pixelSize = bytesPerPixel;
+    dstSurface.pixelSize = srcSurface.pixelSize;
     dstSurface.rotated = true;
 
     KYGXTextureCopyRect srcRect;
@@ -264,7 +676,11 @@ void GLASS_tex_readRect(TextureInfo* tex, u8* dst, size_t face, size_t level, si
     dstRect.width = width;
     dstRect.height = height;
 
+    kygxSyncFlushCacheRegions(&flushSrc, &flushDst, NULL);
     kygxSyncRectCopy(&srcSurface, &srcRect, &dstSurface, &dstRect);
+
+    // Avoid possible prefetches.
+    kygxInvalidateDataCache(dst, dstSize);
 }
 
 void GLASS_tex_writeRect(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height) {
@@ -276,25 +692,17 @@ void GLASS_tex_writeRect(TextureInfo* tex, const u8* data, size_t face, size_t l
     KYGX_ASSERT(kygxIsAligned(y, 8));
     KYGX_ASSERT(kygxIsAligned(width, 8));
     KYGX_ASSERT(kygxIsAligned(height, 8));
-    
-    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
-    const size_t bytesPerPixel = ripGetPixelFormatBPP(pixelFormat) >> 3;
-    const size_t mipmapOffset = ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level);
+
+    KYGXTextureCopySurface dstSurface;
+    getLevelSurface(tex, face, level, &dstSurface);
 
     KYGXTextureCopySurface srcSurface;
     srcSurface.addr = (void*)data;
     srcSurface.width = width;
     srcSurface.height = height;
-    srcSurface.pixelSize = bytesPerPixel;
+    srcSurface.pixelSize = dstSurface.pixelSize;
     srcSurface.rotated = true;
 
-    KYGXTextureCopySurface dstSurface;
-    dstSurface.addr = tex->faces[face] + mipmapOffset;
-    dstSurface.width = tex->width;
-    dstSurface.height = tex->height;
-    dstSurface.pixelSize = bytesPerPixel;
-    dstSurface.rotated = true;
-
     KYGXTextureCopyRect srcRect;
     srcRect.x = 0;
     srcRect.y = 0;
@@ -307,72 +715,263 @@ void GLASS_tex_writeRect(TextureInfo* tex, const u8* data, size_t face, size_t l
     dstRect.width = width;
     dstRect.height = height;
 
-    kygxSyncRectCopy(&srcSurface, &srcRect, &dstSurface, &dstRect);
+    // Only the rows of tiles being written are flushed.
+    const size_t rowSize = dstSurface.width * 8 * dstSurface.pixelSize;
+    u8* dstRows = (u8*)dstSurface.addr + ((y >> 3) * rowSize);
+    CtxCommon* ctx = beginWrite(tex, data, width * height * dstSurface.pixelSize, dstRows, (height >> 3) * rowSize, 1);
+    kygxAddRectCopy(&ctx->GXCmdBuf, &srcSurface, &srcRect, &dstSurface, &dstRect);
+    endWrite(ctx, tex);
+}
+
+// Rect made of the 8x8 tiles covering a rect in OpenGL coordinates, using native coordinates (Y flipped).
+static void getTileRect(const TextureInfo* tex, size_t level, size_t x, size_t y, size_t width, size_t height, KYGXTextureCopyRect* out) {
+    const size_t nativeY = (tex->height >> level) - y - height;
+    out->x = kygxAlignDown(x, 8);
+    out->y = kygxAlignDown(nativeY, 8);
+    out->width = kygxAlignUp(x + width, 8) - out->x;
+    out->height = kygxAlignUp(nativeY + height, 8) - out->y;
 }
 
 void GLASS_tex_readUntiledRect(TextureInfo* tex, u8* dst, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height) {
     KYGX_ASSERT(tex);
     KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
-    KYGX_ASSERT(glassIsLinear(dst));
+    KYGX_ASSERT(dst);
     KYGX_ASSERT(face < getNumFaces(tex->target));
 
     const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
     const size_t bytesPerPixel = ripGetPixelFormatBPP(pixelFormat) >> 3;
 
-    const size_t alignedX = kygxAlignDown(x, 8);
-    const size_t alignedY = kygxAlignDown(y, 8);
-    const size_t alignedWidth = kygxAlignUp(width, 8);
-    const size_t alignedHeight = kygxAlignUp(height, 8);
+    KYGXTextureCopyRect tiles;
+    getTileRect(tex, level, x, y, width, height, &tiles);
 
-    u8* tmpRect = glassLinearAlloc(alignedWidth * alignedHeight * bytesPerPixel);
+    CtxCommon* ctx = GLASS_context_getBound();
+    u8* tmpRect = GLASS_scratch_alloc(ctx, tiles.width * tiles.height * bytesPerPixel);
     KYGX_ASSERT(tmpRect);
 
-    GLASS_tex_readRect(tex, tmpRect, face, level, alignedX, alignedY, alignedWidth, alignedHeight);
-    ripConvertInPlaceFromNative(tmpRect, alignedWidth, alignedHeight, pixelFormat, true);
+    GLASS_tex_readRect(tex, tmpRect, face, level, tiles.x, tiles.y, tiles.width, tiles.height);
+    ripConvertInPlaceFromNative(tmpRect, tiles.width, tiles.height, pixelFormat, true);
 
+    // Untiled rows are in OpenGL order, starting from the bottom of the tiles.
+    const size_t tilesY = (tex->height >> level) - tiles.y - tiles.height;
     const size_t lineWidth = width * bytesPerPixel;
-    size_t srcOffset = ((y - alignedY) * alignedWidth * bytesPerPixel) + ((x - alignedX) * bytesPerPixel);
+    size_t srcOffset = ((y - tilesY) * tiles.width * bytesPerPixel) + ((x - tiles.x) * bytesPerPixel);
     size_t dstOffset = 0;
 
     for (size_t i = 0; i < height; ++i) {
         memcpy(dst + dstOffset, tmpRect + srcOffset, lineWidth);
-        srcOffset += alignedWidth * bytesPerPixel;
+        srcOffset += tiles.width * bytesPerPixel;
         dstOffset += lineWidth;
     }
 
-    glassLinearFree(tmpRect);
+    GLASS_scratch_free(ctx, tmpRect);
 }
 
 void GLASS_tex_writeUntiledRect(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height) {
     KYGX_ASSERT(tex);
     KYGX_ASSERT(data);
     KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
+    KYGX_ASSERT(face < getNumFaces(tex->target));
 
     const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
     const size_t bytesPerPixel = ripGetPixelFormatBPP(pixelFormat) >> 3;
 
-    const size_t alignedX = kygxAlignDown(x, 8);
-    const size_t alignedY = kygxAlignDown(y, 8);
-    const size_t alignedWidth = kygxAlignUp(width, 8);
-    const size_t alignedHeight = kygxAlignUp(height, 8);
+    KYGXTextureCopyRect tiles;
+    getTileRect(tex, level, x, y, width, height, &tiles);
 
-    u8* tmpRect = glassLinearAlloc(alignedWidth * alignedHeight * bytesPerPixel);
+    CtxCommon* ctx = GLASS_context_getBound();
+    u8* tmpRect = GLASS_scratch_alloc(ctx, tiles.width * tiles.height * bytesPerPixel);
     KYGX_ASSERT(tmpRect);
 
-    GLASS_tex_readUntiledRect(tex, tmpRect, face, level, alignedX, alignedY, alignedWidth, alignedHeight);
+    if ((tiles.width == width) && (tiles.height == height)) {
+        // Whole tiles are replaced, nothing to preserve.
+        ripConvertToNative(data, tmpRect, width, height, pixelFormat, true);
+    } else {
+        // Merge the data with the current contents of the tiles.
+        GLASS_tex_readRect(tex, tmpRect, face, level, tiles.x, tiles.y, tiles.width, tiles.height);
+        ripConvertInPlaceFromNative(tmpRect, tiles.width, tiles.height, pixelFormat, true);
+
+        const size_t tilesY = (tex->height >> level) - tiles.y - tiles.height;
+        const size_t lineWidth = width * bytesPerPixel;
+        size_t srcOffset = 0;
+        size_t dstOffset = ((y - tilesY) * tiles.width * bytesPerPixel) + ((x - tiles.x) * bytesPerPixel);
+
+        for (size_t i = 0; i < height; ++i) {
+            memcpy(tmpRect + dstOffset, data + srcOffset, lineWidth);
+            srcOffset += lineWidth;
+            dstOffset += tiles.width * bytesPerPixel;
+        }
 
-    // Write data.
-    const size_t lineWidth = width * bytesPerPixel;
-    size_t srcOffset = 0;
-    size_t dstOffset = ((y - alignedY) * alignedWidth * bytesPerPixel) + ((x - alignedX) * bytesPerPixel);
+        ripConvertInPlaceToNative(tmpRect, tiles.width, tiles.height, pixelFormat, true);
+    }
 
-    for (size_t i = 0; i < height; ++i) {
-        memcpy(tmpRect + dstOffset, data + srcOffset, lineWidth);
-        srcOffset += lineWidth;
-        dstOffset += alignedWidth * bytesPerPixel;
+    // The buffer is reused once the copy is done.
+    GLASS_tex_writeRect(tex, tmpRect, face, level, tiles.x, tiles.y, tiles.width, tiles.height);
+    GLASS_scratch_release(ctx, tmpRect, tex->uploadFence);
+}
+
+static inline bool getRBTransferFormat(GLenum format, u8* out) {
+    switch (format) {
+        case GL_RGBA8_OES:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGBA8;
+            return true;
+        case GL_RGB5_A1:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB5A1;
+            return true;
+        case GL_RGB565:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGB565;
+            return true;
+        case GL_RGBA4:
+            *out = KYGX_DISPLAYTRANSFER_FMT_RGBA4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Surface of a color buffer, as laid out by the GPU (width and height are swapped to account for the rotated screens).
+static void getColorBufferSurface(const RenderbufferInfo* cb, KYGXTextureCopySurface* out) {
+    out->addr = cb->address;
+    out->width = cb->height;
+    out->height = cb->width;
+    out->pixelSize = (cb->format == GL_RGBA8_OES) ? 4 : 2;
+    out->rotated = true;
+}
+
+void GLASS_tex_copyColorBuffer(TextureInfo* tex, size_t face, size_t level, size_t xoffset, size_t yoffset, const RenderbufferInfo* cb, size_t x, size_t y, size_t width, size_t height) {
+    KYGX_ASSERT(tex);
+    KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
+    KYGX_ASSERT(face < getNumFaces(tex->target));
+    KYGX_ASSERT(cb);
+    KYGX_ASSERT(kygxIsAligned(xoffset, 8));
+    KYGX_ASSERT(kygxIsAligned(yoffset, 8));
+    KYGX_ASSERT(kygxIsAligned(x, 8));
+    KYGX_ASSERT(kygxIsAligned(y, 8));
+    KYGX_ASSERT(kygxIsAligned(width, 8));
+    KYGX_ASSERT(kygxIsAligned(height, 8));
+
+    KYGXDisplayTransferFlags transferFlags;
+    if (!getRBTransferFormat(cb->format, &transferFlags.srcFmt) || !getTransferFormat(tex->format, &transferFlags.dstFmt))
+        KYGX_UNREACHABLE("Invalid format!");
+
+    // The copy must see everything drawn so far.
+    GLASS_context_flush(GLASS_context_getBound(), true);
+
+    // Both surfaces are viewed as the GPU renders them, so that the texture looks
+    // the same as if the image was drawn to it directly: rows are OpenGL columns.
+    KYGXTextureCopySurface srcSurface;
+    getColorBufferSurface(cb, &srcSurface);
+
+    KYGXTextureCopyRect srcRect;
+    srcRect.x = y;
+    srcRect.y = x;
+    srcRect.width = height;
+    srcRect.height = width;
+
+    KYGXTextureCopySurface dstSurface;
+    getLevelSurface(tex, face, level, &dstSurface);
+    dstSurface.width = tex->height >> level;
+    dstSurface.height = tex->width >> level;
+
+    KYGXTextureCopyRect dstRect;
+    dstRect.x = yoffset;
+    dstRect.y = xoffset;
+    dstRect.width = height;
+    dstRect.height = width;
+
+    const size_t srcRowSize = srcSurface.width * 8 * srcSurface.pixelSize;
+    const size_t dstRowSize = dstSurface.width * 8 * dstSurface.pixelSize;
+    const u8* srcRows = (const u8*)srcSurface.addr + ((srcRect.y >> 3) * srcRowSize);
+    u8* dstRows = (u8*)dstSurface.addr + ((dstRect.y >> 3) * dstRowSize);
+
+    // Same format, tiles are copied as they are.
+    if (transferFlags.srcFmt == transferFlags.dstFmt) {
+        CtxCommon* ctx = beginWrite(tex, srcRows, (srcRect.height >> 3) * srcRowSize, dstRows, (dstRect.height >> 3) * dstRowSize, 1);
+        kygxAddRectCopy(&ctx->GXCmdBuf, &srcSurface, &srcRect, &dstSurface, &dstRect);
+        endWrite(ctx, tex);
+        return;
+    }
+
+    transferFlags.mode = KYGX_DISPLAYTRANSFER_MODE_T2T;
+    transferFlags.downscale = KYGX_DISPLAYTRANSFER_DOWNSCALE_NONE;
+    transferFlags.verticalFlip = false;
+    transferFlags.blockMode32 = false;
+
+    // The input starts at the first tile of the rect, the output width crops each row.
+    const u8* src = srcRows + ((srcRect.x >> 3) * 64 * srcSurface.pixelSize);
+    const size_t srcSize = (srcRect.height >> 3) * srcRowSize;
+    const size_t convertedSize = width * height * dstSurface.pixelSize;
+
+    // Convert straight into the level when the rect covers it.
+    if ((dstRect.width == dstSurface.width) && (dstRect.height == dstSurface.height)) {
+        CtxCommon* ctx = beginWrite(tex, src, srcSize, dstSurface.addr, convertedSize, 1);
+        kygxAddDisplayTransferChecked(&ctx->GXCmdBuf, src, dstSurface.addr, srcSurface.width, srcRect.height, dstRect.width, dstRect.height, &transferFlags);
+        endWrite(ctx, tex);
+        return;
+    }
+
+    // Otherwise convert into scratch memory first.
+    u8* converted = GLASS_scratch_alloc(GLASS_context_getBound(), convertedSize);
+    KYGX_ASSERT(converted);
+
+    KYGXTextureCopySurface convertedSurface;
+    convertedSurface.addr = converted;
+    convertedSurface.width = dstRect.width;
+    convertedSurface.height = dstRect.height;
+    convertedSurface.pixelSize = dstSurface.pixelSize;
+    convertedSurface.rotated = true;
+
+    KYGXTextureCopyRect convertedRect;
+    convertedRect.x = 0;
+    convertedRect.y = 0;
+    convertedRect.width = dstRect.width;
+    convertedRect.height = dstRect.height;
+
+    CtxCommon* ctx = beginWriteVia(tex, src, srcSize, converted, convertedSize, dstRows, (dstRect.height >> 3) * dstRowSize, 2);
+    kygxAddDisplayTransferChecked(&ctx->GXCmdBuf, src, converted, srcSurface.width, srcRect.height, dstRect.width, dstRect.height, &transferFlags);
+    kygxAddRectCopy(&ctx->GXCmdBuf, &convertedSurface, &convertedRect, &dstSurface, &dstRect);
+    endWrite(ctx, tex);
+    GLASS_scratch_release(ctx, converted, tex->uploadFence);
+}
+
+void GLASS_tex_writeCompressedRect(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height) {
+    KYGX_ASSERT(tex);
+    KYGX_ASSERT(data);
+    KYGX_ASSERT(tex->target != GLASS_TEX_TARGET_UNBOUND);
+    KYGX_ASSERT(face < getNumFaces(tex->target));
+    KYGX_ASSERT((tex->format == TEXFORMAT_ETC1) || (tex->format == TEXFORMAT_ETC1A4));
+    KYGX_ASSERT(kygxIsAligned(x, 8));
+    KYGX_ASSERT(kygxIsAligned(y, 8));
+    KYGX_ASSERT(kygxIsAligned(width, 8));
+    KYGX_ASSERT(kygxIsAligned(height, 8));
+
+    const RIPPixelFormat pixelFormat = getRIPPixelFormat(tex->format);
+    const size_t tileSize = (64 * ripGetPixelFormatBPP(pixelFormat)) >> 3;
+    const size_t levelWidth = tex->width >> level;
+    const size_t nativeY = (tex->height >> level) - y - height;
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    const size_t size = (width * height * ripGetPixelFormatBPP(pixelFormat)) >> 3;
+    u8* tmpRect = GLASS_scratch_alloc(ctx, size);
+    KYGX_ASSERT(tmpRect);
+
+    GLASS_etc_toNative(data, tmpRect, width, height, tex->format == TEXFORMAT_ETC1A4);
+
+    // Each row of tiles is contiguous, copy them as lines with a gap in between.
+    const size_t lineSize = (width >> 3) * tileSize;
+    const size_t levelLineSize = (levelWidth >> 3) * tileSize;
+    u8* dst = tex->faces[face] + ripGetTextureDataOffset(tex->width, tex->height, pixelFormat, level) + ((nativeY >> 3) * levelLineSize) + ((x >> 3) * tileSize);
+    const size_t dstSize = (((height >> 3) - 1) * levelLineSize) + lineSize;
+
+    beginWrite(tex, tmpRect, size, dst, dstSize, 1);
+
+    if (lineSize == levelLineSize) {
+        kygxAddTextureCopy(&ctx->GXCmdBuf, tmpRect, dst, size, 0, 0, 0, 0);
+    } else {
+        kygxAddTextureCopy(&ctx->GXCmdBuf, tmpRect, dst, size, lineSize, 0, lineSize, levelLineSize - lineSize);
     }
 
-    ripConvertInPlaceToNative(tmpRect, alignedWidth, alignedHeight, pixelFormat, true);
-    GLASS_tex_writeRect(tex, tmpRect, face, level, alignedX, alignedY, alignedWidth, alignedHeight);
-    glassLinearFree(tmpRect);
-}
\ No newline at end of file
+    endWrite(ctx, tex);
+
+    // The buffer is reused once the copy is done.
+    GLASS_scratch_release(ctx, tmpRect, tex->uploadFence);
+}
@@ -19,14 +19,24 @@ void GLASS_tex_getAsRenderbuffer(const TextureInfo* tex, size_t face, Renderbuff
 
 void GLASS_tex_setParams(TextureInfo* tex, size_t width, size_t height, GPUTexFormat format, bool vram, u8** faces);
 TexReallocStatus GLASS_tex_realloc(TextureInfo* tex, size_t width, size_t height, GPUTexFormat format, bool vram);
+bool GLASS_tex_move(TextureInfo* tex, bool vram, KYGXVRAMBank bank);
+size_t GLASS_tex_getDataSize(const TextureInfo* tex);
+void GLASS_tex_freeData(TextureInfo* tex);
 
 void GLASS_tex_write(TextureInfo* tex, const u8* data, size_t face, size_t level);
+bool GLASS_tex_generateMipmaps(TextureInfo* tex);
+void GLASS_tex_writeLevels(TextureInfo* tex, const u8* data, size_t face, size_t numLevels);
 void GLASS_tex_writeUntiled(TextureInfo* tex, const u8* data, size_t face, size_t level);
+void GLASS_tex_writeEncoded(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t srcComponents);
+void GLASS_tex_writeConverted(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t srcComponents);
 
 void GLASS_tex_readRect(TextureInfo* tex, u8* dst, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height);
 void GLASS_tex_writeRect(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height);
 
 void GLASS_tex_readUntiledRect(TextureInfo* tex, u8* dst, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height);
+void GLASS_tex_writeCompressedRect(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height);
 void GLASS_tex_writeUntiledRect(TextureInfo* tex, const u8* data, size_t face, size_t level, size_t x, size_t y, size_t width, size_t height);
 
+void GLASS_tex_copyColorBuffer(TextureInfo* tex, size_t face, size_t level, size_t xoffset, size_t yoffset, const RenderbufferInfo* cb, size_t x, size_t y, size_t width, size_t height);
+
 #endif /* _GLASS_TEXMANAGER_H */
\ No newline at end of file
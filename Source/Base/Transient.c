@@ -0,0 +1,172 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "Base/MemStats.h"
+#include "Base/TexManager.h"
+#include "Base/Transient.h"
+#include "Base/VRAM.h"
+
+/*
+ * Storage for render targets that only live within a frame.
+ * Blocks are handed out by size, and go back to the pool when the target is discarded or
+ * when the frame ends. A block given back during a frame can be handed out again in the
+ * same frame: the GPU executes commands in order, so the new target can't overwrite data
+ * the previous one still needs.
+ */
+
+// Blocks not used for this many frames are freed.
+#define MAX_IDLE_FRAMES 4
+
+void GLASS_transient_init(TransientPool* pool) {
+    KYGX_ASSERT(pool);
+    pool->blocks = NULL;
+}
+
+static TransientBlock* findBlock(TransientPool* pool, size_t size, KYGXVRAMBank bank) {
+    TransientBlock* best = NULL;
+
+    for (TransientBlock* block = pool->blocks; block; block = block->next) {
+        // Don't waste big blocks on small targets.
+        if ((block->owner != GLASS_INVALID_OBJECT) || (block->size < size) || (block->size > (size << 1)))
+            continue;
+
+        if ((bank != KYGX_ALLOC_VRAM_BANK_ANY) && (GLASS_vram_getBank(block->address) != bank))
+            continue;
+
+        if (!best || (block->size < best->size))
+            best = block;
+    }
+
+    return best;
+}
+
+u8* GLASS_transient_acquire(CtxCommon* ctx, GLuint owner, size_t size, KYGXVRAMBank bank) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(owner != GLASS_INVALID_OBJECT);
+
+    TransientPool* pool = &ctx->transientPool;
+
+    // Prefer the requested bank, but any block is better than a new one.
+    TransientBlock* block = findBlock(pool, size, bank);
+    if (!block && (bank != KYGX_ALLOC_VRAM_BANK_ANY))
+        block = findBlock(pool, size, KYGX_ALLOC_VRAM_BANK_ANY);
+
+    if (block) {
+        // Memory fills are not part of the command list, send pending draws to the previous user first.
+        if (block->used)
+            GLASS_context_flush(ctx, true);
+    } else {
+        block = (TransientBlock*)glassHeapAlloc(sizeof(TransientBlock));
+        if (!block)
+            return NULL;
+
+        block->address = GLASS_vram_allocPreferred(size, bank);
+        if (!block->address) {
+            glassHeapFree(block);
+            return NULL;
+        }
+
+        GLASS_memStats_add(GLASS_MEMORY_RENDERBUFFERS, block->address, size, GLASS_INVALID_OBJECT);
+        block->size = size;
+        block->next = pool->blocks;
+        pool->blocks = block;
+    }
+
+    block->owner = owner;
+    block->idleFrames = 0;
+    block->used = true;
+
+    // Objects are shared between contexts, remember where the storage has to go back.
+    if (GLASS_OBJ_IS_RENDERBUFFER(owner)) {
+        ((RenderbufferInfo*)owner)->transientPool = pool;
+    } else {
+        KYGX_ASSERT(GLASS_OBJ_IS_TEXTURE(owner));
+        ((TextureInfo*)owner)->transientPool = pool;
+    }
+
+    return block->address;
+}
+
+void GLASS_transient_release(TransientPool* pool, const u8* address) {
+    if (!address)
+        return;
+
+    KYGX_ASSERT(pool);
+
+    for (TransientBlock* block = pool->blocks; block; block = block->next) {
+        if (block->address == address) {
+            block->owner = GLASS_INVALID_OBJECT;
+            return;
+        }
+    }
+
+    KYGX_UNREACHABLE("Invalid transient block!");
+}
+
+// Take back the storage of a target still alive at the end of the frame.
+static void detachOwner(GLuint owner) {
+    if (GLASS_OBJ_IS_RENDERBUFFER(owner)) {
+        RenderbufferInfo* info = (RenderbufferInfo*)owner;
+        info->address = NULL;
+        info->transientPool = NULL;
+    } else {
+        KYGX_ASSERT(GLASS_OBJ_IS_TEXTURE(owner));
+        TextureInfo* tex = (TextureInfo*)owner;
+        tex->faces[0] = NULL;
+        tex->transientPool = NULL;
+        tex->width = 0;
+        tex->height = 0;
+    }
+
+    GLASS_invalidateFramebuffers();
+}
+
+void GLASS_transient_destroy(TransientPool* pool) {
+    KYGX_ASSERT(pool);
+
+    TransientBlock* block = pool->blocks;
+    while (block) {
+        TransientBlock* next = block->next;
+
+        if (block->owner != GLASS_INVALID_OBJECT)
+            detachOwner(block->owner);
+
+        GLASS_memStats_remove(GLASS_MEMORY_RENDERBUFFERS, block->address, block->size);
+        GLASS_vram_free(block->address);
+        glassHeapFree(block);
+        block = next;
+    }
+
+    pool->blocks = NULL;
+}
+
+void GLASS_transient_endFrame(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+
+    TransientBlock** link = &ctx->transientPool.blocks;
+
+    while (*link) {
+        TransientBlock* block = *link;
+
+        if (block->owner != GLASS_INVALID_OBJECT) {
+            detachOwner(block->owner);
+            block->owner = GLASS_INVALID_OBJECT;
+            ctx->flags |= (GLASS_CONTEXT_FLAG_FRAMEBUFFER | GLASS_CONTEXT_FLAG_TEXTURE);
+        }
+
+        // Free blocks that are not needed anymore.
+        if (!block->used && (++block->idleFrames > MAX_IDLE_FRAMES)) {
+            *link = block->next;
+            GLASS_memStats_remove(GLASS_MEMORY_RENDERBUFFERS, block->address, block->size);
+            GLASS_vram_free(block->address);
+            glassHeapFree(block);
+            continue;
+        }
+
+        block->used = false;
+        link = &block->next;
+    }
+}
@@ -0,0 +1,19 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_TRANSIENT_H
+#define _GLASS_BASE_TRANSIENT_H
+
+#include "Base/Context.h"
+
+void GLASS_transient_init(TransientPool* pool);
+void GLASS_transient_destroy(TransientPool* pool);
+
+u8* GLASS_transient_acquire(CtxCommon* ctx, GLuint owner, size_t size, KYGXVRAMBank bank);
+void GLASS_transient_release(TransientPool* pool, const u8* address);
+void GLASS_transient_endFrame(CtxCommon* ctx);
+
+#endif /* _GLASS_BASE_TRANSIENT_H */
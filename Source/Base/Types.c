@@ -4,39 +4,186 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+/**
+ * Objects of each type are allocated from slabs of contiguous slots.
+ * Slots are never released, and a free slot has no type, so that
+ * dangling pointers fail type checks. Names given to the application
+ * are handles made of the slot index and a generation which changes
+ * each time the slot is freed: they can be validated without reading
+ * memory at an address chosen by the application.
+ */
 #include "Types.h"
 
-GLuint GLASS_createObject(u32 type) {
-    size_t objSize = 0;
+#include <string.h> // memcpy, memset
+
+#define NAME_INDEX_MASK 0xFFFF
+#define NAME_TYPE_SHIFT 16
+#define NAME_TYPE_MASK 0xF
+#define NAME_GENERATION_SHIFT 20
+#define NAME_GENERATION_MASK 0xFFF
+
+#define MAX_SLABS ((NAME_INDEX_MASK + 1) / GLASS_OBJECTS_PER_SLAB)
 
+typedef struct {
+    u32 type;    // Object type, 0 if the slot is free.
+    GLuint name; // Object name, or index + 1 of the next free slot.
+} ObjectHeader;
+
+typedef struct {
+    u8* objects;                             // Contiguous slots.
+    u16 generations[GLASS_OBJECTS_PER_SLAB]; // Generation of each slot.
+} ObjectSlab;
+
+typedef struct {
+    ObjectSlab** slabs; // Allocated slabs.
+    size_t numSlabs;    // Num of allocated slabs.
+    size_t capacity;    // Capacity of the slab list.
+    size_t objSize;     // Size of a slot.
+    u32 freeSlot;       // Index + 1 of the first free slot, 0 if none.
+} ObjectPool;
+
+static ObjectPool g_Pools[GLASS_NUM_OBJECT_TYPES];
+static u32 g_FramebufferEpoch = 1;
+
+static size_t getObjectSize(u32 type) {
     switch (type) {
         case GLASS_BUFFER_TYPE:
-            objSize = sizeof(BufferInfo);
-            break;
+            return sizeof(BufferInfo);
         case GLASS_RENDERBUFFER_TYPE:
-            objSize = sizeof(RenderbufferInfo);
-            break;
+            return sizeof(RenderbufferInfo);
         case GLASS_FRAMEBUFFER_TYPE:
-            objSize = sizeof(FramebufferInfo);
-            break;
+            return sizeof(FramebufferInfo);
         case GLASS_PROGRAM_TYPE:
-            objSize = sizeof(ProgramInfo);
-            break;
+            return sizeof(ProgramInfo);
         case GLASS_SHADER_TYPE:
-            objSize = sizeof(ShaderInfo);
-            break;
+            return sizeof(ShaderInfo);
         case GLASS_TEXTURE_TYPE:
-            objSize = sizeof(TextureInfo);
-            break;
-        default:
-            return GLASS_INVALID_OBJECT;
+            return sizeof(TextureInfo);
+    }
+
+    return 0;
+}
+
+static inline ObjectHeader* getSlot(const ObjectPool* pool, size_t index) {
+    const ObjectSlab* slab = pool->slabs[index / GLASS_OBJECTS_PER_SLAB];
+    return (ObjectHeader*)(slab->objects + ((index % GLASS_OBJECTS_PER_SLAB) * pool->objSize));
+}
+
+static inline u16* getGeneration(const ObjectPool* pool, size_t index) {
+    return &pool->slabs[index / GLASS_OBJECTS_PER_SLAB]->generations[index % GLASS_OBJECTS_PER_SLAB];
+}
+
+static bool addSlab(ObjectPool* pool) {
+    if (pool->numSlabs == MAX_SLABS)
+        return false;
+
+    if (pool->numSlabs == pool->capacity) {
+        const size_t newCapacity = pool->capacity ? (pool->capacity << 1) : 4;
+        ObjectSlab** slabs = (ObjectSlab**)glassHeapAlloc(newCapacity * sizeof(ObjectSlab*));
+        if (!slabs)
+            return false;
+
+        if (pool->slabs) {
+            memcpy(slabs, pool->slabs, pool->numSlabs * sizeof(ObjectSlab*));
+            glassHeapFree(pool->slabs);
+        }
+
+        pool->slabs = slabs;
+        pool->capacity = newCapacity;
+    }
+
+    ObjectSlab* slab = (ObjectSlab*)glassHeapAlloc(sizeof(ObjectSlab));
+    if (!slab)
+        return false;
+
+    slab->objects = (u8*)glassHeapAlloc(pool->objSize * GLASS_OBJECTS_PER_SLAB);
+    if (!slab->objects) {
+        glassHeapFree(slab);
+        return false;
     }
 
-    u32* obj = (u32*)glassHeapAlloc(objSize);
-    if (obj) {
-        *obj = type;
-        return (GLuint)obj;
+    pool->slabs[pool->numSlabs++] = slab;
+
+    // Chain the new slots, in order.
+    const size_t first = (pool->numSlabs - 1) * GLASS_OBJECTS_PER_SLAB;
+    for (size_t i = 0; i < GLASS_OBJECTS_PER_SLAB; ++i) {
+        ObjectHeader* header = getSlot(pool, first + i);
+        header->type = 0;
+        header->name = (i == (GLASS_OBJECTS_PER_SLAB - 1)) ? pool->freeSlot : (first + i + 2);
     }
 
-    return GLASS_INVALID_OBJECT;
-}
\ No newline at end of file
+    pool->freeSlot = first + 1;
+    return true;
+}
+
+GLuint GLASS_createObject(u32 type) {
+    const size_t objSize = getObjectSize(type);
+    if (!objSize)
+        return GLASS_INVALID_OBJECT;
+
+    ObjectPool* pool = &g_Pools[type];
+    pool->objSize = objSize;
+
+    if (!pool->freeSlot && !addSlab(pool))
+        return GLASS_INVALID_OBJECT;
+
+    const size_t index = pool->freeSlot - 1;
+    ObjectHeader* header = getSlot(pool, index);
+    pool->freeSlot = header->name;
+
+    memset(header, 0, objSize);
+    header->type = type;
+    header->name = ((*getGeneration(pool, index) & NAME_GENERATION_MASK) << NAME_GENERATION_SHIFT) | (type << NAME_TYPE_SHIFT) | index;
+    return (GLuint)header;
+}
+
+void GLASS_destroyObject(GLuint obj) {
+    if (obj == GLASS_INVALID_OBJECT)
+        return;
+
+    ObjectHeader* header = (ObjectHeader*)obj;
+    KYGX_ASSERT(header->type && (header->type < GLASS_NUM_OBJECT_TYPES));
+
+    ObjectPool* pool = &g_Pools[header->type];
+    const size_t index = header->name & NAME_INDEX_MASK;
+
+    // Invalidate names of this slot.
+    ++(*getGeneration(pool, index));
+
+    header->type = 0;
+    header->name = pool->freeSlot;
+    pool->freeSlot = index + 1;
+}
+
+GLuint GLASS_getObjectName(GLuint obj) {
+    if (obj == GLASS_INVALID_OBJECT)
+        return GLASS_INVALID_OBJECT;
+
+    const ObjectHeader* header = (ObjectHeader*)obj;
+    return header->type ? header->name : GLASS_INVALID_OBJECT;
+}
+
+GLuint GLASS_getObject(GLuint name, u32 type) {
+    if ((name == GLASS_INVALID_OBJECT) || (((name >> NAME_TYPE_SHIFT) & NAME_TYPE_MASK) != type))
+        return GLASS_INVALID_OBJECT;
+
+    const ObjectPool* pool = &g_Pools[type];
+    const size_t index = name & NAME_INDEX_MASK;
+    if (index >= (pool->numSlabs * GLASS_OBJECTS_PER_SLAB))
+        return GLASS_INVALID_OBJECT;
+
+    if ((*getGeneration(pool, index) & NAME_GENERATION_MASK) != (name >> NAME_GENERATION_SHIFT))
+        return GLASS_INVALID_OBJECT;
+
+    ObjectHeader* header = getSlot(pool, index);
+    return (header->type == type) ? (GLuint)header : GLASS_INVALID_OBJECT;
+}
+
+// Attachments and their storage are shared between framebuffers, so any change invalidates every cached status.
+void GLASS_invalidateFramebuffers(void) {
+    // Epoch 0 marks a status that was never computed.
+    if (!++g_FramebufferEpoch)
+        g_FramebufferEpoch = 1;
+}
+
+u32 GLASS_getFramebufferEpoch(void) { return g_FramebufferEpoch; }
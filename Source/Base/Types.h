@@ -32,6 +32,15 @@
 #define GLASS_NUM_TEX_FACES 6
 #define GLASS_MAX_VIEWPORT_WIDTH 1016
 #define GLASS_MAX_VIEWPORT_HEIGHT 1023
+#define GLASS_NUM_BUFFER_POOL_CLASSES 11
+#define GLASS_MIN_BUFFER_POOL_CLASS_SHIFT 6
+#define GLASS_MAX_BUFFER_POOL_CACHED 8
+#define GLASS_MAX_DIRTY_RANGES 15
+#define GLASS_GX_CMD_BUFFER_SIZE 32
+
+// Commands added by a submit: dirty range flushes, three ranges each, and the command list.
+#define GLASS_GX_SUBMIT_CMDS (((GLASS_MAX_DIRTY_RANGES + 2) / 3) + 1)
+#define GLASS_MAX_QUEUED_GX_CMDS (GLASS_GX_CMD_BUFFER_SIZE - GLASS_GX_SUBMIT_CMDS)
 
 // Last value is encoded as a difference.
 #define GLASS_NUM_FOG_LUT_ENTRIES (GLASS_NUM_FOG_LUT_VALUES - 1)
@@ -90,7 +99,11 @@
 
 #define GLASS_OBJ_IS_TEXTURE(x) GLASS_checkObjectType((x), GLASS_TEXTURE_TYPE)
 
-#define GLASS_OBJ(name) u32 _glObjectType
+#define GLASS_OBJ(name) u32 _glObjectType; GLuint _glObjectName
+
+// Objects are exposed through handles: generation (12 bits), type (4 bits), slot index (16 bits).
+#define GLASS_NUM_OBJECT_TYPES 7
+#define GLASS_OBJECTS_PER_SLAB 32
 
 typedef struct {
     KYGXMtx mtx;
@@ -102,20 +115,76 @@ typedef struct {
     u32 glObjectType; // GL object type.
 } GLObjectInfo;
 
+typedef struct BufferPoolEntry {
+    struct BufferPoolEntry* next;    // Next entry.
+    u8* address;                     // Data address.
+    size_t capacity;                 // Allocation size.
+    u32 fence;                       // Fence that must complete before reuse.
+    GLBUFFERRELEASEPROCPICA release; // Release callback for external storage.
+} BufferPoolEntry;
+
+typedef struct {
+    BufferPoolEntry* classes[GLASS_NUM_BUFFER_POOL_CLASSES]; // Cached blocks, by size class.
+    size_t numCached[GLASS_NUM_BUFFER_POOL_CLASSES];         // Num of cached blocks, by size class.
+    BufferPoolEntry* deferred;                               // Blocks waiting for their fence before being freed.
+    BufferPoolEntry* freeEntries;                            // Unused entries.
+} BufferPool;
+
+typedef struct {
+    u32 start; // Start address, cache line aligned.
+    u32 end;   // End address, cache line aligned.
+} DirtyRange;
+
+typedef struct TransientBlock {
+    struct TransientBlock* next; // Next block.
+    u8* address;                 // VRAM block.
+    size_t size;                 // Block size.
+    GLuint owner;                // Target using the block, GLASS_INVALID_OBJECT if available.
+    u8 idleFrames;               // Num of frames the block has not been used for.
+    bool used;                   // Whether the block has been used during this frame.
+} TransientBlock;
+
+typedef struct {
+    TransientBlock* blocks; // Render target storage, available or in use.
+} TransientPool;
+
+typedef struct {
+    u8* base;        // Arena memory.
+    size_t capacity; // Arena size.
+    size_t offset;   // Offset of the first free byte.
+    size_t numLive;  // Num of allocations not released yet.
+    u32 fence;       // Fence that must complete before the arena is reset.
+} ScratchArena;
+
+typedef struct ReadbackInfo ReadbackInfo;
+
 typedef struct {
     GLASS_OBJ(GLASS_BUFFER_TYPE);
-    u8* address;  // Data address.
-    GLenum usage; // Buffer usage type.
-    bool bound;   // If this buffer has been bound.
+    u8* address;                     // Data address.
+    size_t size;                     // Data size.
+    u32 fence;                       // Fence of the last draw using this buffer.
+    GLBUFFERRELEASEPROCPICA release; // Release callback, if the storage is owned by the application.
+    GLenum usage;                    // Buffer usage type.
+    GLbitfield mapAccess;            // Map access flags, 0 if not mapped.
+    size_t mapOffset;                // Offset of the mapped range.
+    size_t mapLength;                // Size of the mapped range.
+    ReadbackInfo* pendingReads;      // Pixels read into this buffer, written to storage on access.
+    bool vram;                       // Allocate data on VRAM.
+    bool purgeable;                  // Data can be freed when over budget.
+    bool bound;                      // If this buffer has been bound.
 } BufferInfo;
 
 typedef struct {
     GLASS_OBJ(GLASS_RENDERBUFFER_TYPE);
-    u8* address;    // Data address.
-    GLsizei width;  // Buffer width.
-    GLsizei height; // Buffer height.
-    GLenum format;  // Buffer format.
-    bool bound;     // If this renderbuffer has been bound.
+    u8* address;                  // Data address.
+    GLsizei width;                // Buffer width.
+    GLsizei height;               // Buffer height.
+    GLenum format;                // Buffer format.
+    GLenum vramBank;              // Pinned VRAM bank, GL_NONE if any.
+    TransientPool* transientPool; // Pool the transient storage comes from.
+    bool transient;               // Storage comes from the transient pool.
+    bool bound;                   // If this renderbuffer has been bound.
+    bool bankPending;             // Data is moved to the pinned bank at the end of the frame.
 } RenderbufferInfo;
 
 typedef struct {
@@ -124,6 +193,10 @@ typedef struct {
     GLuint depthBuffer; // Bound depth (+ stencil) buffer.
     size_t texFace;     // Texture object face.
     bool bound;         // If this framebuffer has been bound.
+    GLenum status;      // Cached completeness status.
+    u32 statusEpoch;    // Attachment epoch of the cached status, 0 if none.
+    bool unbalanced;    // Attachments share a VRAM bank, balanced at the end of the frame.
+    bool balanceDepth;  // Whether the depth buffer was attached last.
 } FramebufferInfo;
 
 typedef struct {
@@ -214,7 +287,18 @@ typedef struct {
     float lodBias;                  // LOD bias.
     u8 minLod;                      // Min level of details.
     u8 maxLod;                      // Max level of details.
+    GLenum vramBank;                // Pinned VRAM bank, GL_NONE if any.
+    u32 uses;                       // Vertices drawn with this texture since the last residency update.
+    u32 heat;                       // Decaying amount of uses.
+    u32 fence;                      // Fence of the last draw using this texture.
+    u32 uploadFence;                // Fence of the last upload to this texture.
     bool vram;                      // Allocate data on VRAM.
+    bool purgeable;                 // Data can be freed when over budget.
+    TransientPool* transientPool;   // Pool the transient storage comes from.
+    bool transient;                 // Storage comes from the transient pool.
+    bool manualVRAM;                // VRAM placement was chosen by the application.
+    bool managed;                   // Placement is handled by the residency manager.
+    bool bankPending;               // Data is moved to the pinned bank at the end of the frame.
 } TextureInfo;
 
 typedef struct {
@@ -244,6 +328,13 @@ typedef struct {
 } CombinerInfo;
 
 GLuint GLASS_createObject(u32 type);
+void GLASS_destroyObject(GLuint obj);
+
+GLuint GLASS_getObjectName(GLuint obj);
+GLuint GLASS_getObject(GLuint name, u32 type);
+
+void GLASS_invalidateFramebuffers(void);
+u32 GLASS_getFramebufferEpoch(void);
 
 static inline bool GLASS_checkObjectType(GLuint obj, uint32_t type) {
     if (obj != GLASS_INVALID_OBJECT)
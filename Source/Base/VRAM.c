@@ -0,0 +1,246 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <KYGX/Wrappers/FlushCacheRegions.h>
+#include <KYGX/Wrappers/TextureCopy.h>
+
+#include "Base/Context.h"
+#include "Base/MemStats.h"
+#include "Base/TexManager.h"
+#include "Base/VRAM.h"
+
+#include <string.h> // memcpy
+
+#ifdef KYGX_BAREMETAL
+#include <mem_map.h> // VRAM_BASE
+#define VRAM_PHYS_BASE VRAM_BASE
+#else
+#define VRAM_PHYS_BASE OS_VRAM_PADDR
+#endif // KYGX_BAREMETAL
+
+// VRAM is split in two banks of equal size.
+#define VRAM_BANK_SIZE 0x300000
+
+static size_t g_BankUsage[2];
+
+// Textures and renderbuffers which might hold VRAM storage.
+static GLuint* g_Residents = NULL;
+static size_t g_NumResidents = 0;
+static size_t g_ResidentsCapacity = 0;
+
+typedef struct {
+    GLuint obj;  // Tracked object.
+    u8* address; // VRAM storage.
+} CompactEntry;
+
+static inline size_t getBankIndex(KYGXVRAMBank bank) {
+    KYGX_ASSERT(bank != KYGX_ALLOC_VRAM_BANK_ANY);
+    return (bank == KYGX_ALLOC_VRAM_BANK_A) ? 0 : 1;
+}
+
+u8* GLASS_vram_alloc(size_t size, KYGXVRAMBank bank) {
+    u8* p = glassVRAMAlloc(size, bank);
+    if (p)
+        g_BankUsage[getBankIndex(GLASS_vram_getBank(p))] += glassVRAMSize(p);
+
+    return p;
+}
+
+u8* GLASS_vram_allocPreferred(size_t size, KYGXVRAMBank bank) {
+    u8* p = GLASS_vram_alloc(size, bank);
+
+    if (!p && (bank != KYGX_ALLOC_VRAM_BANK_ANY))
+        p = GLASS_vram_alloc(size, GLASS_vram_getOppositeBank(bank));
+
+    return p;
+}
+
+void GLASS_vram_free(void* p) {
+    if (!p)
+        return;
+
+    const size_t index = getBankIndex(GLASS_vram_getBank(p));
+    const size_t size = glassVRAMSize(p);
+    KYGX_ASSERT(g_BankUsage[index] >= size);
+
+    g_BankUsage[index] -= size;
+    glassVRAMFree(p);
+}
+
+KYGXVRAMBank GLASS_vram_getBank(const void* p) {
+    KYGX_ASSERT(glassIsVRAM(p));
+
+    const u32 offset = kygxGetPhysicalAddress(p) - VRAM_PHYS_BASE;
+    return (offset < VRAM_BANK_SIZE) ? KYGX_ALLOC_VRAM_BANK_A : KYGX_ALLOC_VRAM_BANK_B;
+}
+
+size_t GLASS_vram_getUsage(KYGXVRAMBank bank) { return g_BankUsage[getBankIndex(bank)]; }
+
+static void copyBlock(const void* src, void* dst, size_t size) {
+    KYGXFlushCacheRegionsBuffer flushSrc;
+    flushSrc.addr = src;
+    flushSrc.size = size;
+
+    KYGXFlushCacheRegionsBuffer flushDst;
+    flushDst.addr = dst;
+    flushDst.size = size;
+
+    kygxSyncFlushCacheRegions(&flushSrc, &flushDst, NULL);
+    kygxSyncTextureCopy(src, dst, size, 0, 0, 0, 0);
+
+    // Avoid possible prefetches.
+    kygxInvalidateDataCache(dst, size);
+}
+
+u8* GLASS_vram_move(void* p, KYGXVRAMBank bank) {
+    KYGX_ASSERT(p);
+
+    // Data might come from linear memory.
+    const bool isVRAM = glassIsVRAM(p);
+    const size_t size = isVRAM ? glassVRAMSize(p) : glassLinearSize(p);
+
+    u8* q = GLASS_vram_alloc(size, bank);
+    if (!q)
+        return NULL;
+
+    copyBlock(p, q, size);
+    isVRAM ? GLASS_vram_free(p) : glassLinearFree(p);
+    return q;
+}
+
+void GLASS_vram_track(GLuint obj) {
+    for (size_t i = 0; i < g_NumResidents; ++i) {
+        if (g_Residents[i] == obj)
+            return;
+    }
+
+    if (g_NumResidents == g_ResidentsCapacity) {
+        const size_t newCapacity = g_ResidentsCapacity ? (g_ResidentsCapacity << 1) : 32;
+        GLuint* residents = (GLuint*)glassHeapAlloc(newCapacity * sizeof(GLuint));
+
+        // The object just won't be compacted.
+        if (!residents)
+            return;
+
+        if (g_Residents) {
+            memcpy(residents, g_Residents, g_NumResidents * sizeof(GLuint));
+            glassHeapFree(g_Residents);
+        }
+
+        g_Residents = residents;
+        g_ResidentsCapacity = newCapacity;
+    }
+
+    g_Residents[g_NumResidents++] = obj;
+}
+
+void GLASS_vram_untrack(GLuint obj) {
+    for (size_t i = 0; i < g_NumResidents; ++i) {
+        if (g_Residents[i] == obj) {
+            g_Residents[i] = g_Residents[--g_NumResidents];
+            return;
+        }
+    }
+}
+
+// VRAM storage of a tracked object, NULL if none.
+static u8* getStorage(GLuint obj) {
+    if (GLASS_OBJ_IS_TEXTURE(obj)) {
+        const TextureInfo* tex = (const TextureInfo*)obj;
+        return (tex->vram && !tex->transient) ? tex->faces[0] : NULL;
+    }
+
+    if (GLASS_OBJ_IS_RENDERBUFFER(obj)) {
+        const RenderbufferInfo* info = (const RenderbufferInfo*)obj;
+        return (!info->transient && glassIsVRAM(info->address)) ? info->address : NULL;
+    }
+
+    return NULL;
+}
+
+// Whether a block of the same size would be placed lower in the same bank.
+static bool canMoveDown(const u8* p) {
+    u8* q = GLASS_vram_alloc(glassVRAMSize(p), GLASS_vram_getBank(p));
+    if (!q)
+        return false;
+
+    const bool lower = q < p;
+    GLASS_vram_free(q);
+    return lower;
+}
+
+static bool moveDown(GLuint obj, u8* p) {
+    const KYGXVRAMBank bank = GLASS_vram_getBank(p);
+
+    if (GLASS_OBJ_IS_TEXTURE(obj))
+        return GLASS_tex_move((TextureInfo*)obj, true, bank);
+
+    RenderbufferInfo* info = (RenderbufferInfo*)obj;
+    u8* q = GLASS_vram_move(p, bank);
+    if (!q)
+        return false;
+
+    GLASS_memStats_move(GLASS_MEMORY_RENDERBUFFERS, p, q, glassVRAMSize(q));
+    info->address = q;
+    return true;
+}
+
+bool GLASS_vram_compact(void) {
+    if (!g_NumResidents)
+        return false;
+
+    CompactEntry* entries = (CompactEntry*)glassHeapAlloc(g_NumResidents * sizeof(CompactEntry));
+    if (!entries)
+        return false;
+
+    // Moving textures updates the list, work on a copy.
+    size_t numEntries = 0;
+    for (size_t i = 0; i < g_NumResidents; ++i) {
+        CompactEntry* e = &entries[numEntries];
+        e->obj = g_Residents[i];
+        e->address = getStorage(e->obj);
+
+        if (e->address)
+            ++numEntries;
+    }
+
+    // Sort by address, lower first.
+    for (size_t i = 1; i < numEntries; ++i) {
+        const CompactEntry e = entries[i];
+
+        size_t j = i;
+        for (; (j > 0) && (entries[j - 1].address > e.address); --j)
+            entries[j] = entries[j - 1];
+
+        entries[j] = e;
+    }
+
+    // Slide each object into the lowest hole that fits it, so that free space gathers at the top of each bank.
+    CtxCommon* ctx = GLASS_context_getBound();
+    size_t numMoved = 0;
+
+    for (size_t i = 0; i < numEntries; ++i) {
+        CompactEntry* e = &entries[i];
+        if (!canMoveDown(e->address))
+            continue;
+
+        // Wait for the GPU to be done with the old data.
+        if (!numMoved) {
+            GLASS_context_flush(ctx, true);
+            kygxWaitCompletion();
+        }
+
+        if (moveDown(e->obj, e->address))
+            ++numMoved;
+    }
+
+    glassHeapFree(entries);
+
+    if (numMoved)
+        ctx->flags |= (GLASS_CONTEXT_FLAG_TEXTURE | GLASS_CONTEXT_FLAG_FRAMEBUFFER);
+
+    return numMoved > 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef _GLASS_BASE_VRAM_H
+#define _GLASS_BASE_VRAM_H
+
+#include "Base/Types.h"
+
+u8* GLASS_vram_alloc(size_t size, KYGXVRAMBank bank);
+u8* GLASS_vram_allocPreferred(size_t size, KYGXVRAMBank bank);
+void GLASS_vram_free(void* p);
+
+KYGXVRAMBank GLASS_vram_getBank(const void* p);
+size_t GLASS_vram_getUsage(KYGXVRAMBank bank);
+
+u8* GLASS_vram_move(void* p, KYGXVRAMBank bank);
+
+void GLASS_vram_track(GLuint obj);
+void GLASS_vram_untrack(GLuint obj);
+bool GLASS_vram_compact(void);
+
+static inline KYGXVRAMBank GLASS_vram_getOppositeBank(KYGXVRAMBank bank) {
+    KYGX_ASSERT(bank != KYGX_ALLOC_VRAM_BANK_ANY);
+    return (bank == KYGX_ALLOC_VRAM_BANK_A) ? KYGX_ALLOC_VRAM_BANK_B : KYGX_ALLOC_VRAM_BANK_A;
+}
+
+// Convert a bank token to a KYGX bank, 0 means any bank.
+static inline KYGXVRAMBank GLASS_vram_unwrapBank(GLenum bank) {
+    switch (bank) {
+        case GL_VRAM_BANK_A_PICA:
+            return KYGX_ALLOC_VRAM_BANK_A;
+        case GL_VRAM_BANK_B_PICA:
+            return KYGX_ALLOC_VRAM_BANK_B;
+        default:
+            return KYGX_ALLOC_VRAM_BANK_ANY;
+    }
+}
+
+static inline GLenum GLASS_vram_wrapBank(KYGXVRAMBank bank) {
+    switch (bank) {
+        case KYGX_ALLOC_VRAM_BANK_A:
+            return GL_VRAM_BANK_A_PICA;
+        case KYGX_ALLOC_VRAM_BANK_B:
+            return GL_VRAM_BANK_B_PICA;
+        default:
+            return GL_NONE;
+    }
+}
+
+#endif /* _GLASS_BASE_VRAM_H */
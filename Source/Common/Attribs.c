@@ -17,7 +17,9 @@ void glBindAttribLocation(GLuint program, GLuint index, const GLchar* name) {
     return;
 }
 
-GLint glGetAttribLocation(GLuint program, const GLchar* name) {
+GLint glGetAttribLocation(GLuint programName, const GLchar* name) {
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return -1;
@@ -108,7 +110,7 @@ static bool readInt(size_t index, GLenum pname, GLint* param) {
 
     switch (pname) {
         case GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING:
-            *param = attrib->boundBuffer;
+            *param = GLASS_getObjectName(attrib->boundBuffer);
             return true;
         case GL_VERTEX_ATTRIB_ARRAY_SIZE:
             *param = attrib->count;
@@ -326,9 +328,6 @@ void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean norm
             GLASS_context_setError(GL_INVALID_OPERATION);
             return;
         }
-
-        if (!ctx->params.flushAllLinearMem)
-            kygxSyncFlushSingleBuffer(pointer, bufferSize);
     }
 
     // Check alignment.
@@ -368,11 +367,13 @@ void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean norm
 }
 
 // TODO: this function looks fishy.
-void glGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+void glGetActiveAttrib(GLuint programName, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
     KYGX_ASSERT(size);
     KYGX_ASSERT(type);
     KYGX_ASSERT(name);
 
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -5,11 +5,21 @@
  */
 
 #include <KYGX/Wrappers/FlushCacheRegions.h>
+#include <KYGX/Wrappers/TextureCopy.h>
+#include <KYGX/Utility.h>
 
+#include "Base/Budget.h"
+#include "Base/BufferPool.h"
 #include "Base/Context.h"
+#include "Base/Math.h"
+#include "Base/MemStats.h"
+#include "Base/Read.h"
+#include "Base/VRAM.h"
 
 #include <string.h> // memcpy
 
+#define VRAM_COPY_ALIGNMENT 16
+
 static BufferInfo* getBoundBufferInfo(GLenum target) {
     GLuint buffer = GLASS_INVALID_OBJECT;
     CtxCommon* ctx = GLASS_context_getBound();
@@ -21,6 +31,9 @@ static BufferInfo* getBoundBufferInfo(GLenum target) {
         case GL_ELEMENT_ARRAY_BUFFER:
             buffer = ctx->elementArrayBuffer;
             break;
+        case GL_PIXEL_PACK_BUFFER_NV:
+            buffer = ctx->pixelPackBuffer;
+            break;
         default:
             GLASS_context_setError(GL_INVALID_ENUM);
             return NULL;
@@ -33,10 +46,172 @@ static BufferInfo* getBoundBufferInfo(GLenum target) {
     return NULL;
 }
 
-void glBindBuffer(GLenum target, GLuint buffer) {
-    KYGX_ASSERT(GLASS_OBJ_IS_BUFFER(buffer) || buffer == GLASS_INVALID_OBJECT);
+static void updateAttribsForBuffer(CtxCommon* ctx, GLuint buffer) {
+    KYGX_ASSERT(ctx);
+
+    const BufferInfo* info = (BufferInfo*)buffer;
+
+    for (size_t i = 0; i < GLASS_NUM_ATTRIB_REGS; ++i) {
+        AttributeInfo* attrib = &ctx->attribs[i];
+
+        if (!(attrib->flags & GLASS_ATTRIB_FLAG_FIXED) && (attrib->boundBuffer == buffer)) {
+            attrib->physAddr = kygxGetPhysicalAddress(info->address);
+            KYGX_ASSERT(attrib->physAddr);
+            ctx->flags |= GLASS_CONTEXT_FLAG_ATTRIBS;
+        }
+    }
+}
+
+static void releaseVRAM(GLvoid* data, GLsizeiptr size) {
+    (void)size;
+    GLASS_vram_free(data);
+}
+
+// Size of the memory taken by buffer storage.
+static inline size_t getStorageSize(const u8* address, size_t size) {
+    return glassIsVRAM(address) ? glassVRAMSize(address) : GLASS_bufferPool_getCapacity(size);
+}
+
+// Give the storage back to its owner once the GPU is done with it.
+static void releaseStorage(CtxCommon* ctx, BufferInfo* info) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(info);
+
+    GLASS_read_discardPack(info);
+
+    // Application owned storage is not accounted.
+    if (info->address && !info->release)
+        GLASS_memStats_remove(GLASS_MEMORY_BUFFERS, info->address, getStorageSize(info->address, info->size));
+
+    if (info->release) {
+        GLASS_bufferPool_releaseExternal(ctx, info->address, info->size, info->fence, info->release);
+        info->release = NULL;
+    } else if (info->address && glassIsVRAM(info->address)) {
+        GLASS_bufferPool_releaseExternal(ctx, info->address, info->size, info->fence, releaseVRAM);
+    } else {
+        GLASS_bufferPool_release(ctx, info->address, info->size, info->fence);
+    }
+
+    info->address = NULL;
+}
+
+static u8* allocStorageImpl(CtxCommon* ctx, const BufferInfo* info, size_t size, bool vram) {
+    // Purge other objects to stay within budget.
+    const size_t allocSize = vram ? size : GLASS_bufferPool_getCapacity(size);
+    if (!GLASS_budget_reserve(ctx, vram, allocSize, (GLuint)info))
+        return NULL;
+
+    u8* address = vram ? GLASS_vram_alloc(size, KYGX_ALLOC_VRAM_BANK_ANY) : GLASS_bufferPool_acquire(ctx, size);
+
+    // Last resort: purge other objects.
+    if (!address && GLASS_budget_purge(ctx, vram, allocSize, (GLuint)info))
+        address = vram ? GLASS_vram_alloc(size, KYGX_ALLOC_VRAM_BANK_ANY) : GLASS_bufferPool_acquire(ctx, size);
+
+    if (address)
+        GLASS_memStats_add(GLASS_MEMORY_BUFFERS, address, getStorageSize(address, size), (GLuint)info);
+
+    return address;
+}
+
+// VRAM is only a hint, fallback to linear memory.
+static u8* allocStorage(CtxCommon* ctx, const BufferInfo* info, size_t size) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(info);
+
+    if (info->vram) {
+        u8* address = allocStorageImpl(ctx, info, size, true);
+        if (address)
+            return address;
+    }
+
+    return allocStorageImpl(ctx, info, size, false);
+}
+
+// Whether the current storage can hold new data of the specified size.
+static bool storageFits(const BufferInfo* info, size_t size) {
+    KYGX_ASSERT(info);
+
+    if (!info->address || info->release)
+        return false;
+
+    if (glassIsVRAM(info->address))
+        return info->vram && (glassVRAMSize(info->address) >= size);
+
+    return !info->vram && (GLASS_bufferPool_getCapacity(info->size) == GLASS_bufferPool_getCapacity(size));
+}
+
+// Write data to buffer storage, VRAM is written through GX copies.
+static bool writeStorage(CtxCommon* ctx, u8* dst, const u8* src, size_t size) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(dst);
+    KYGX_ASSERT(src);
+
+    if (!size)
+        return true;
+
+    const bool aligned = kygxIsAligned((u32)dst, VRAM_COPY_ALIGNMENT) && kygxIsAligned(size, VRAM_COPY_ALIGNMENT);
 
-    BufferInfo*info = (BufferInfo*)buffer;
+    if (!glassIsVRAM(dst) || !aligned) {
+        memcpy(dst, src, size);
+
+        if (glassIsVRAM(dst)) {
+            kygxSyncFlushSingleBuffer(dst, size);
+        } else {
+            GLASS_context_markDirty(ctx, dst, size);
+        }
+
+        return true;
+    }
+
+    // Allocate a temp buffer if data isn't accessible by the GPU.
+    const bool isOriginLinear = glassIsLinear(src) || glassIsVRAM(src);
+    if (!isOriginLinear) {
+        u8* p = glassLinearAlloc(size);
+        if (!p)
+            return false;
+
+        memcpy(p, src, size);
+        src = p;
+    }
+
+    kygxSyncFlushSingleBuffer(src, size);
+    kygxSyncTextureCopy(src, dst, size, 0, 0, 0, 0);
+
+    // Avoid possible prefetches.
+    kygxInvalidateDataCache(dst, size);
+
+    if (!isOriginLinear)
+        glassLinearFree((void*)src);
+
+    return true;
+}
+
+// Replace the buffer storage with a block the GPU is not using.
+static bool orphanBuffer(CtxCommon* ctx, BufferInfo* info, size_t size, bool keepData) {
+    KYGX_ASSERT(ctx);
+    KYGX_ASSERT(info);
+
+    u8* address = allocStorage(ctx, info, size);
+    if (!address)
+        return false;
+
+    if (keepData)
+        GLASS_read_resolvePack(info);
+
+    if (keepData && info->address)
+        writeStorage(ctx, address, info->address, GLASS_MIN(info->size, size));
+
+    releaseStorage(ctx, info);
+    info->address = address;
+    info->fence = ctx->completedFence;
+    return true;
+}
+
+void glBindBuffer(GLenum target, GLuint name) {
+    const GLuint buffer = GLASS_getObject(name, GLASS_BUFFER_TYPE);
+    KYGX_ASSERT(GLASS_OBJ_IS_BUFFER(buffer) || name == GLASS_INVALID_OBJECT);
+
+    BufferInfo* info = (BufferInfo*)buffer;
     CtxCommon* ctx = GLASS_context_getBound();
 
     // Bind buffer to context.
@@ -47,6 +222,9 @@ void glBindBuffer(GLenum target, GLuint buffer) {
         case GL_ELEMENT_ARRAY_BUFFER:
             ctx->elementArrayBuffer = buffer;
             break;
+        case GL_PIXEL_PACK_BUFFER_NV:
+            ctx->pixelPackBuffer = buffer;
+            break;
         default:
             GLASS_context_setError(GL_INVALID_ENUM);
             return;
@@ -72,25 +250,27 @@ void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage
     if (!info)
         return;
 
-    // Allocate buffer.
-    if (info->address)
-        glassLinearFree(info->address);
+    // Keep the current storage if it fits and the GPU is done with it, otherwise orphan it.
+    CtxCommon* ctx = GLASS_context_getBound();
+    GLASS_read_discardPack(info);
 
-    info->address = glassLinearAlloc(size);
-    if (!info->address) {
-        GLASS_context_setError(GL_OUT_OF_MEMORY);
-        return;
+    if (!storageFits(info, size) || !GLASS_context_isFenceDone(ctx, info->fence)) {
+        if (!orphanBuffer(ctx, info, size, false)) {
+            releaseStorage(ctx, info);
+            info->size = 0;
+            GLASS_context_setError(GL_OUT_OF_MEMORY);
+            return;
+        }
+
+        updateAttribsForBuffer(ctx, (GLuint)info);
     }
 
+    info->size = size;
     info->usage = usage;
+    info->mapAccess = 0;
 
-    if (data) {
-        memcpy(info->address, data, size);
-
-        CtxCommon* ctx = GLASS_context_getBound();
-        if (!ctx->params.flushAllLinearMem)
-            kygxSyncFlushSingleBuffer(info->address, size);
-    }
+    if (data && !writeStorage(ctx, info->address, data, size))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
 }
 
 void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
@@ -107,18 +287,104 @@ void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void
         return;
 
     // Get buffer size.
-    GLsizeiptr bufSize = (GLsizeiptr)glassLinearSize(info->address);
+    GLsizeiptr bufSize = (GLsizeiptr)info->size;
     if (size > (bufSize - offset)) {
         GLASS_context_setError(GL_INVALID_VALUE);
         return;
     }
 
+    if (info->mapAccess) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // Pixels read into the buffer must not land over the new data.
+    const bool replacesAll = (offset == 0) && (size == bufSize);
+    if (replacesAll) {
+        GLASS_read_discardPack(info);
+    } else {
+        GLASS_read_resolvePack(info);
+    }
+
+    // Don't write over data the GPU might still be reading.
+    CtxCommon* ctx = GLASS_context_getBound();
+
+    if (!GLASS_context_isFenceDone(ctx, info->fence)) {
+        if (!orphanBuffer(ctx, info, info->size, !replacesAll)) {
+            GLASS_context_setError(GL_OUT_OF_MEMORY);
+            return;
+        }
+
+        updateAttribsForBuffer(ctx, (GLuint)info);
+    }
+
     // Copy data.
-    memcpy(info->address + offset, data, size);
+    if (!writeStorage(ctx, info->address + offset, data, size))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+}
+
+void glBufferStorageExternalPICA(GLenum target, GLvoid* data, GLsizeiptr size, GLBUFFERRELEASEPROCPICA release) {
+    // Application owned storage must never reach the buffer pool, so a release callback is required.
+    if (!data || !release || (size < 0)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    // The GPU must be able to read the storage.
+    if (!kygxGetPhysicalAddress(data)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    // Get buffer.
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return;
 
+    // Adopt storage, the previous one is released as usual.
     CtxCommon* ctx = GLASS_context_getBound();
-    if (!ctx->params.flushAllLinearMem)
-        kygxSyncFlushSingleBuffer(info->address + offset, size);
+    releaseStorage(ctx, info);
+
+    info->address = (u8*)data;
+    info->size = size;
+    info->fence = ctx->completedFence;
+    info->release = release;
+    info->mapAccess = 0;
+    updateAttribsForBuffer(ctx, (GLuint)info);
+    GLASS_context_markDirty(ctx, info->address, size);
+}
+
+void glBufferPurgeablePICA(GLenum target, GLboolean purgeable) {
+    // Get buffer.
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (info && !GLASS_budget_setPurgeable((GLuint)info, purgeable))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+}
+
+void glBufferVRAMPICA(GLenum target, GLboolean enabled) {
+    // Get buffer.
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return;
+
+    if (info->mapAccess) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    info->vram = enabled;
+
+    // Move existing data, unless it's owned by the application.
+    if (!info->address || info->release || (glassIsVRAM(info->address) == (bool)enabled))
+        return;
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    if (!orphanBuffer(ctx, info, info->size, true)) {
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+        return;
+    }
+
+    updateAttribsForBuffer(ctx, (GLuint)info);
 }
 
 void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
@@ -132,7 +398,7 @@ void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
     CtxCommon* ctx = GLASS_context_getBound();
 
     for (size_t i = 0; i < n; ++i) {
-        GLuint name = buffers[i];
+        GLuint name = GLASS_getObject(buffers[i], GLASS_BUFFER_TYPE);
 
         // Validate name.
         if (!GLASS_OBJ_IS_BUFFER(name))
@@ -147,11 +413,22 @@ void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
         if (ctx->elementArrayBuffer == name)
             ctx->elementArrayBuffer = GLASS_INVALID_OBJECT;
 
-        // Delete buffer.
-        if (info->address)
-            glassLinearFree(info->address);
+        if (ctx->pixelPackBuffer == name)
+            ctx->pixelPackBuffer = GLASS_INVALID_OBJECT;
+
+        for (size_t j = 0; j < GLASS_NUM_ATTRIB_REGS; ++j) {
+            AttributeInfo* attrib = &ctx->attribs[j];
+            if (attrib->boundBuffer == name) {
+                attrib->boundBuffer = GLASS_INVALID_OBJECT;
+                attrib->physAddr = 0;
+                ctx->flags |= GLASS_CONTEXT_FLAG_ATTRIBS;
+            }
+        }
 
-        glassHeapFree(info);
+        // Delete buffer, the GPU might still be using its storage.
+        GLASS_budget_setPurgeable(name, false);
+        releaseStorage(ctx, info);
+        GLASS_destroyObject(name);
     }
 }
 
@@ -172,7 +449,7 @@ void glGenBuffers(GLsizei n, GLuint* buffers) {
 
         BufferInfo* info = (BufferInfo*)name;
         info->usage = GL_STATIC_DRAW;
-        buffers[i] = name;
+        buffers[i] = GLASS_getObjectName(name);
     }
 }
 
@@ -185,17 +462,24 @@ void glGetBufferParameteriv(GLenum target, GLenum pname, GLint* data) {
 
     switch (pname) {
         case GL_BUFFER_SIZE:
-            *data = glassLinearSize(info->address);
+            *data = info->size;
             break;
         case GL_BUFFER_USAGE:
             *data = info->usage;
             break;
+        case GL_BUFFER_ACCESS_OES:
+            *data = GL_WRITE_ONLY_OES;
+            break;
+        case GL_BUFFER_MAPPED_OES:
+            *data = info->mapAccess ? GL_TRUE : GL_FALSE;
+            break;
         default:
             GLASS_context_setError(GL_INVALID_ENUM);
     }
 }
 
-GLboolean glIsBuffer(GLuint buffer) {
+GLboolean glIsBuffer(GLuint name) {
+    const GLuint buffer = GLASS_getObject(name, GLASS_BUFFER_TYPE);
     if (GLASS_OBJ_IS_BUFFER(buffer)) {
         const BufferInfo* info = (BufferInfo*)buffer;
         if (info->bound)
@@ -203,4 +487,149 @@ GLboolean glIsBuffer(GLuint buffer) {
     }
 
     return GL_FALSE;
-}
\ No newline at end of file
+}
+
+void glFlushMappedBufferRangeEXT(GLenum target, GLintptr offset, GLsizeiptr length) {
+    // Get buffer.
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return;
+
+    if (!(info->mapAccess & GL_MAP_FLUSH_EXPLICIT_BIT_EXT)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    if ((offset < 0) || (length < 0) || (length > ((GLsizeiptr)info->mapLength - offset))) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    // Only flush the bytes that were written.
+    CtxCommon* ctx = GLASS_context_getBound();
+    GLASS_context_markDirty(ctx, info->address + info->mapOffset + offset, length);
+}
+
+void glGetBufferPointervOES(GLenum target, GLenum pname, GLvoid** params) {
+    KYGX_ASSERT(params);
+
+    if (pname != GL_BUFFER_MAP_POINTER_OES) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return;
+
+    *params = info->mapAccess ? (info->address + info->mapOffset) : NULL;
+}
+
+static inline bool isValidMapAccess(GLbitfield access) {
+    const GLbitfield allBits = GL_MAP_READ_BIT_EXT | GL_MAP_WRITE_BIT_EXT | GL_MAP_INVALIDATE_RANGE_BIT_EXT
+        | GL_MAP_INVALIDATE_BUFFER_BIT_EXT | GL_MAP_FLUSH_EXPLICIT_BIT_EXT | GL_MAP_UNSYNCHRONIZED_BIT_EXT;
+    const GLbitfield writeOnlyBits = GL_MAP_INVALIDATE_RANGE_BIT_EXT | GL_MAP_INVALIDATE_BUFFER_BIT_EXT
+        | GL_MAP_FLUSH_EXPLICIT_BIT_EXT | GL_MAP_UNSYNCHRONIZED_BIT_EXT;
+
+    if (access & ~allBits)
+        return false;
+
+    if (!(access & (GL_MAP_READ_BIT_EXT | GL_MAP_WRITE_BIT_EXT)))
+        return false;
+
+    if ((access & GL_MAP_READ_BIT_EXT) && (access & (GL_MAP_INVALIDATE_RANGE_BIT_EXT | GL_MAP_INVALIDATE_BUFFER_BIT_EXT | GL_MAP_UNSYNCHRONIZED_BIT_EXT)))
+        return false;
+
+    if (!(access & GL_MAP_WRITE_BIT_EXT) && (access & writeOnlyBits))
+        return false;
+
+    return true;
+}
+
+void* glMapBufferRangeEXT(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    if ((offset < 0) || (length <= 0)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return NULL;
+    }
+
+    // Get buffer.
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return NULL;
+
+    if (length > ((GLsizeiptr)info->size - offset)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return NULL;
+    }
+
+    // VRAM storage can't be mapped.
+    if (info->mapAccess || !isValidMapAccess(access) || glassIsVRAM(info->address)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return NULL;
+    }
+
+    // Pixels read into the buffer are only needed if part of it is kept.
+    if (access & GL_MAP_INVALIDATE_BUFFER_BIT_EXT) {
+        GLASS_read_discardPack(info);
+    } else {
+        GLASS_read_resolvePack(info);
+    }
+
+    // Make sure the GPU is not reading the range we're about to hand out.
+    CtxCommon* ctx = GLASS_context_getBound();
+
+    if (!(access & GL_MAP_UNSYNCHRONIZED_BIT_EXT) && !GLASS_context_isFenceDone(ctx, info->fence)) {
+        if (access & (GL_MAP_INVALIDATE_RANGE_BIT_EXT | GL_MAP_INVALIDATE_BUFFER_BIT_EXT)) {
+            // Previous contents are only needed if part of the buffer is kept.
+            const bool replacesAll = (access & GL_MAP_INVALIDATE_BUFFER_BIT_EXT) || ((offset == 0) && (length == info->size));
+            if (!orphanBuffer(ctx, info, info->size, !replacesAll)) {
+                GLASS_context_setError(GL_OUT_OF_MEMORY);
+                return NULL;
+            }
+
+            updateAttribsForBuffer(ctx, (GLuint)info);
+        } else {
+            GLASS_context_waitFence(ctx, info->fence);
+        }
+    }
+
+    info->mapAccess = access;
+    info->mapOffset = offset;
+    info->mapLength = length;
+    return info->address + offset;
+}
+
+void* glMapBufferOES(GLenum target, GLenum access) {
+    if (access != GL_WRITE_ONLY_OES) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return NULL;
+    }
+
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return NULL;
+
+    return glMapBufferRangeEXT(target, 0, info->size, GL_MAP_WRITE_BIT_EXT);
+}
+
+GLboolean glUnmapBufferOES(GLenum target) {
+    // Get buffer.
+    BufferInfo* info = getBoundBufferInfo(target);
+    if (!info)
+        return GL_FALSE;
+
+    if (!info->mapAccess) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return GL_FALSE;
+    }
+
+    // Flush the whole range, unless the application did it explicitly.
+    CtxCommon* ctx = GLASS_context_getBound();
+    if ((info->mapAccess & GL_MAP_WRITE_BIT_EXT) && !(info->mapAccess & GL_MAP_FLUSH_EXPLICIT_BIT_EXT))
+        GLASS_context_markDirty(ctx, info->address + info->mapOffset, info->mapLength);
+
+    info->mapAccess = 0;
+    info->mapOffset = 0;
+    info->mapLength = 0;
+    return GL_TRUE;
+}
@@ -6,11 +6,17 @@
 
 #include <KYGX/Utility.h>
 
+#include "Base/Budget.h"
 #include "Base/Context.h"
+#include "Base/MemStats.h"
+#include "Base/Residency.h"
 #include "Base/TexManager.h"
+#include "Base/Transient.h"
+#include "Base/VRAM.h"
 
-void glBindFramebuffer(GLenum target, GLuint framebuffer) {
-    KYGX_ASSERT(GLASS_OBJ_IS_FRAMEBUFFER(framebuffer) || framebuffer == GLASS_INVALID_OBJECT);
+void glBindFramebuffer(GLenum target, GLuint name) {
+    const GLuint framebuffer = GLASS_getObject(name, GLASS_FRAMEBUFFER_TYPE);
+    KYGX_ASSERT(GLASS_OBJ_IS_FRAMEBUFFER(framebuffer) || name == GLASS_INVALID_OBJECT);
 
     if (target != GL_FRAMEBUFFER) {
         GLASS_context_setError(GL_INVALID_ENUM);
@@ -32,8 +38,9 @@ void glBindFramebuffer(GLenum target, GLuint framebuffer) {
     }
 }
 
-void glBindRenderbuffer(GLenum target, GLuint renderbuffer) {
-    KYGX_ASSERT(GLASS_OBJ_IS_RENDERBUFFER(renderbuffer) || renderbuffer == GLASS_INVALID_OBJECT);
+void glBindRenderbuffer(GLenum target, GLuint name) {
+    const GLuint renderbuffer = GLASS_getObject(name, GLASS_RENDERBUFFER_TYPE);
+    KYGX_ASSERT(GLASS_OBJ_IS_RENDERBUFFER(renderbuffer) || name == GLASS_INVALID_OBJECT);
 
     if (target != GL_RENDERBUFFER) {
         GLASS_context_setError(GL_INVALID_ENUM);
@@ -52,21 +59,7 @@ void glBindRenderbuffer(GLenum target, GLuint renderbuffer) {
     }
 }
 
-GLenum glCheckFramebufferStatus(GLenum target) {
-    if (target != GL_FRAMEBUFFER) {
-        GLASS_context_setError(GL_INVALID_ENUM);
-        return 0;
-    }
-
-    CtxCommon* ctx = GLASS_context_getBound();
-    const size_t fbIndex = GLASS_context_getFBIndex(ctx);
-
-    // Make sure we have a framebuffer.
-    if (!GLASS_OBJ_IS_FRAMEBUFFER(ctx->framebuffer[fbIndex]))
-        return GL_FRAMEBUFFER_UNSUPPORTED;
-
-    FramebufferInfo* info = (FramebufferInfo*)ctx->framebuffer[fbIndex];
-
+static GLenum computeStatus(const FramebufferInfo* info) {
     // Check that we have at least one attachment.
     if ((info->colorBuffer == GLASS_INVALID_OBJECT) && (info->depthBuffer == GLASS_INVALID_OBJECT))
         return GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT;
@@ -105,6 +98,31 @@ GLenum glCheckFramebufferStatus(GLenum target) {
     return GL_FRAMEBUFFER_COMPLETE;
 }
 
+GLenum glCheckFramebufferStatus(GLenum target) {
+    if (target != GL_FRAMEBUFFER) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return 0;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    const size_t fbIndex = GLASS_context_getFBIndex(ctx);
+
+    // Make sure we have a framebuffer.
+    if (!GLASS_OBJ_IS_FRAMEBUFFER(ctx->framebuffer[fbIndex]))
+        return GL_FRAMEBUFFER_UNSUPPORTED;
+
+    FramebufferInfo* info = (FramebufferInfo*)ctx->framebuffer[fbIndex];
+
+    // Revalidate only if attachments have changed since the last check.
+    const u32 epoch = GLASS_getFramebufferEpoch();
+    if (info->statusEpoch != epoch) {
+        info->status = computeStatus(info);
+        info->statusEpoch = epoch;
+    }
+
+    return info->status;
+}
+
 void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
     KYGX_ASSERT(framebuffers);
 
@@ -116,7 +134,7 @@ void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
     CtxCommon* ctx = GLASS_context_getBound();
 
     for (size_t i = 0; i < n; ++i) {
-        GLuint name = framebuffers[i];
+        GLuint name = GLASS_getObject(framebuffers[i], GLASS_FRAMEBUFFER_TYPE);
 
         // Validate name.
         if (!GLASS_OBJ_IS_FRAMEBUFFER(name))
@@ -129,8 +147,29 @@ void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
         }
 
         // Delete framebuffer.
-        glassHeapFree((FramebufferInfo*)name);
+        GLASS_destroyObject(name);
+    }
+}
+
+static void freeRenderbufferStorage(RenderbufferInfo* info) {
+    GLASS_invalidateFramebuffers();
+
+    // Transient storage goes back to the pool.
+    if (info->transient) {
+        GLASS_transient_release(info->transientPool, info->address);
+        info->address = NULL;
+        info->transientPool = NULL;
+        return;
     }
+
+    GLASS_vram_untrack((GLuint)info);
+
+    u8* p = info->address;
+    if (p)
+        GLASS_memStats_remove(GLASS_MEMORY_RENDERBUFFERS, p, glassVRAMSize(p));
+
+    GLASS_vram_free(p);
+    info->address = NULL;
 }
 
 void glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
@@ -150,7 +189,7 @@ void glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
         fbInfo = (FramebufferInfo*)ctx->framebuffer[fbIndex];
 
     for (size_t i = 0; i < n; ++i) {
-        GLuint name = renderbuffers[i];
+        GLuint name = GLASS_getObject(renderbuffers[i], GLASS_RENDERBUFFER_TYPE);
 
         // Validate name.
         if (!GLASS_OBJ_IS_RENDERBUFFER(name))
@@ -168,20 +207,91 @@ void glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
         }
 
         // Delete renderbuffer.
-        if (info->address)
-            glassVRAMFree(info->address);
+        freeRenderbufferStorage(info);
+        GLASS_destroyObject(name);
+    }
+}
 
-        glassHeapFree(info);
+void glDiscardFramebufferEXT(GLenum target, GLsizei numAttachments, const GLenum* attachments) {
+    KYGX_ASSERT(attachments);
+
+    if (target != GL_FRAMEBUFFER) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    if (numAttachments < 0) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
     }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    const size_t fbIndex = GLASS_context_getFBIndex(ctx);
+
+    // Nothing to discard for the screen framebuffer.
+    if (!GLASS_OBJ_IS_FRAMEBUFFER(ctx->framebuffer[fbIndex]))
+        return;
+
+    FramebufferInfo* info = (FramebufferInfo*)ctx->framebuffer[fbIndex];
+
+    for (size_t i = 0; i < numAttachments; ++i) {
+        GLuint name = GLASS_INVALID_OBJECT;
+
+        switch (attachments[i]) {
+            case GL_COLOR_ATTACHMENT0:
+                name = info->colorBuffer;
+                break;
+            case GL_DEPTH_ATTACHMENT:
+            case GL_STENCIL_ATTACHMENT:
+                name = info->depthBuffer;
+                break;
+            default:
+                GLASS_context_setError(GL_INVALID_ENUM);
+                return;
+        }
+
+        // Only transient storage can be given back, contents of other objects are kept.
+        if (GLASS_OBJ_IS_RENDERBUFFER(name)) {
+            RenderbufferInfo* rb = (RenderbufferInfo*)name;
+            if (rb->transient && rb->address) {
+                freeRenderbufferStorage(rb);
+                ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
+            }
+        } else if (GLASS_OBJ_IS_TEXTURE(name)) {
+            TextureInfo* tex = (TextureInfo*)name;
+            if (tex->transient && tex->faces[0]) {
+                GLASS_tex_freeData(tex);
+                ctx->flags |= (GLASS_CONTEXT_FLAG_FRAMEBUFFER | GLASS_CONTEXT_FLAG_TEXTURE);
+            }
+        }
+    }
+}
+
+static u8* getColorAddress(const FramebufferInfo* info) {
+    if (GLASS_OBJ_IS_RENDERBUFFER(info->colorBuffer))
+        return ((RenderbufferInfo*)info->colorBuffer)->address;
+
+    if (GLASS_OBJ_IS_TEXTURE(info->colorBuffer))
+        return ((TextureInfo*)info->colorBuffer)->faces[info->texFace];
+
+    return NULL;
+}
+
+static u8* getDepthAddress(const FramebufferInfo* info) {
+    if (GLASS_OBJ_IS_RENDERBUFFER(info->depthBuffer))
+        return ((RenderbufferInfo*)info->depthBuffer)->address;
+
+    return NULL;
 }
 
-void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) {
+void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint name) {
     if ((target != GL_FRAMEBUFFER) || (renderbuffertarget != GL_RENDERBUFFER)) {
         GLASS_context_setError(GL_INVALID_ENUM);
         return;
     }
 
-    if (!GLASS_OBJ_IS_RENDERBUFFER(renderbuffer) && renderbuffer != GLASS_INVALID_OBJECT) {
+    const GLuint renderbuffer = GLASS_getObject(name, GLASS_RENDERBUFFER_TYPE);
+    if (!GLASS_OBJ_IS_RENDERBUFFER(renderbuffer) && name != GLASS_INVALID_OBJECT) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
@@ -211,10 +321,12 @@ void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbu
             return;
     }
 
+    GLASS_invalidateFramebuffers();
+    GLASS_residency_balanceBanks(fbInfo, attachment != GL_COLOR_ATTACHMENT0);
     ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
 }
 
-void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint name, GLint level) {
     if (target != GL_FRAMEBUFFER) {
         GLASS_context_setError(GL_INVALID_ENUM);
         return;
@@ -237,12 +349,14 @@ void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget,
     FramebufferInfo* fbInfo = (FramebufferInfo*)ctx->framebuffer[fbIndex];
 
     // Handle the case where we need to remove the binding.
-    if (texture == GLASS_INVALID_OBJECT) {
+    if (name == GLASS_INVALID_OBJECT) {
         fbInfo->colorBuffer = GLASS_INVALID_OBJECT;
+        GLASS_invalidateFramebuffers();
         return;
     }
 
     // Do additional checks.
+    const GLuint texture = GLASS_getObject(name, GLASS_TEXTURE_TYPE);
     if (!GLASS_OBJ_IS_TEXTURE(texture)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -299,6 +413,8 @@ void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget,
     // Set texture object.
     fbInfo->colorBuffer = texture;
     fbInfo->texFace = face;
+    GLASS_invalidateFramebuffers();
+    GLASS_residency_balanceBanks(fbInfo, false);
     ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
 }
 
@@ -317,10 +433,34 @@ void glGenFramebuffers(GLsizei n, GLuint* framebuffers) {
             return;
         }
 
-        framebuffers[i] = name;
+        framebuffers[i] = GLASS_getObjectName(name);
     }
 }
 
+void glGenerateMipmap(GLenum target) {
+    if (target != GL_TEXTURE_2D && target != GL_TEXTURE_CUBE_MAP) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
+
+    // We don't support default textures.
+    if (!tex || tex->target != target || !tex->faces[0]) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // Only formats supported by display transfers can be downscaled.
+    if (!GLASS_tex_generateMipmaps(tex)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
+}
+
 void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
     KYGX_ASSERT(renderbuffers);
 
@@ -338,7 +478,7 @@ void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
 
         RenderbufferInfo* info = (RenderbufferInfo*)name;
         info->format = GL_RGBA8_OES;
-        renderbuffers[i] = name;
+        renderbuffers[i] = GLASS_getObjectName(name);
     }
 }
 
@@ -419,13 +559,17 @@ void glGetRenderbufferParameteriv(GLenum target, GLenum pname, GLint* params) {
         case GL_RENDERBUFFER_STENCIL_SIZE:
             *params = info->format == GL_DEPTH24_STENCIL8_OES ? 8 : 0;
             break;
+        case GL_VRAM_BANK_PICA:
+            *params = glassIsVRAM(info->address) ? GLASS_vram_wrapBank(GLASS_vram_getBank(info->address)) : GL_NONE;
+            break;
         default:
             GLASS_context_setError(GL_INVALID_ENUM);
             return;
     }
 }
 
-GLboolean glIsFramebuffer(GLuint framebuffer) {
+GLboolean glIsFramebuffer(GLuint name) {
+    const GLuint framebuffer = GLASS_getObject(name, GLASS_FRAMEBUFFER_TYPE);
     if (GLASS_OBJ_IS_FRAMEBUFFER(framebuffer)) {
         FramebufferInfo* info = (FramebufferInfo*)framebuffer;
         if (info->bound)
@@ -435,7 +579,8 @@ GLboolean glIsFramebuffer(GLuint framebuffer) {
     return GL_FALSE;
 }
 
-GLboolean glIsRenderbuffer(GLuint renderbuffer) {
+GLboolean glIsRenderbuffer(GLuint name) {
+    const GLuint renderbuffer = GLASS_getObject(name, GLASS_RENDERBUFFER_TYPE);
     if (GLASS_OBJ_IS_RENDERBUFFER(renderbuffer)) {
         RenderbufferInfo* info = (RenderbufferInfo*)renderbuffer;
         if (info->bound)
@@ -445,6 +590,38 @@ GLboolean glIsRenderbuffer(GLuint renderbuffer) {
     return GL_FALSE;
 }
 
+void glReleaseTransientStoragePICA(GLuint name) {
+    const GLuint renderbuffer = GLASS_getObject(name, GLASS_RENDERBUFFER_TYPE);
+    const GLuint texture = GLASS_getObject(name, GLASS_TEXTURE_TYPE);
+
+    if (!GLASS_OBJ_IS_RENDERBUFFER(renderbuffer) && !GLASS_OBJ_IS_TEXTURE(texture)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+
+    if (GLASS_OBJ_IS_RENDERBUFFER(renderbuffer)) {
+        RenderbufferInfo* info = (RenderbufferInfo*)renderbuffer;
+        if (!info->transient) {
+            GLASS_context_setError(GL_INVALID_OPERATION);
+            return;
+        }
+
+        freeRenderbufferStorage(info);
+        ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
+    } else {
+        TextureInfo* tex = (TextureInfo*)texture;
+        if (!tex->transient) {
+            GLASS_context_setError(GL_INVALID_OPERATION);
+            return;
+        }
+
+        GLASS_tex_freeData(tex);
+        ctx->flags |= (GLASS_CONTEXT_FLAG_FRAMEBUFFER | GLASS_CONTEXT_FLAG_TEXTURE);
+    }
+}
+
 static inline bool isColorFormat(GLenum format) {
     switch (format) {
         case GL_RGBA8_OES:
@@ -487,6 +664,29 @@ static inline size_t getBytesPerPixel(GLenum format) {
     return 0;
 }
 
+static u8* allocRenderbufferStorage(CtxCommon* ctx, const RenderbufferInfo* info, size_t size, bool isDepth) {
+    // Pinned buffers stay in their bank.
+    if (info->vramBank != GL_NONE) {
+        const KYGXVRAMBank bank = GLASS_vram_unwrapBank(info->vramBank);
+        return info->transient ? GLASS_transient_acquire(ctx, (GLuint)info, size, bank) : GLASS_vram_alloc(size, bank);
+    }
+
+    // Place the buffer opposite to the other attachment of the bound framebuffer, if any.
+    KYGXVRAMBank bank = isDepth ? KYGX_ALLOC_VRAM_BANK_B : KYGX_ALLOC_VRAM_BANK_A;
+
+    const size_t fbIndex = GLASS_context_getFBIndex(ctx);
+    if (GLASS_OBJ_IS_FRAMEBUFFER(ctx->framebuffer[fbIndex])) {
+        const FramebufferInfo* fbInfo = (FramebufferInfo*)ctx->framebuffer[fbIndex];
+        const GLuint self = isDepth ? fbInfo->depthBuffer : fbInfo->colorBuffer;
+        const u8* other = isDepth ? getColorAddress(fbInfo) : getDepthAddress(fbInfo);
+
+        if ((self == (GLuint)info) && other && glassIsVRAM(other))
+            bank = GLASS_vram_getOppositeBank(GLASS_vram_getBank(other));
+    }
+
+    return info->transient ? GLASS_transient_acquire(ctx, (GLuint)info, size, bank) : GLASS_vram_allocPreferred(size, bank);
+}
+
 void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {
     if ((target != GL_RENDERBUFFER) || (!isColorFormat(internalformat) && !isDepthFormat(internalformat))) {
         GLASS_context_setError(GL_INVALID_ENUM);
@@ -517,21 +717,84 @@ void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width,
     // Allocate buffer.
     const size_t bufferSize = width * height * getBytesPerPixel(internalformat);
 
-    if (info->address)
-        glassVRAMFree(info->address);
+    freeRenderbufferStorage(info);
+
+    // Purge other objects to stay within budget.
+    if (!GLASS_budget_reserve(ctx, true, bufferSize, GLASS_INVALID_OBJECT)) {
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+        return;
+    }
 
+    // VRAM might be fragmented, compact it and retry.
     const bool isDepth = isDepthFormat(internalformat);
-    info->address = glassVRAMAlloc(bufferSize, isDepth ? KYGX_ALLOC_VRAM_BANK_B : KYGX_ALLOC_VRAM_BANK_A);
+    info->address = allocRenderbufferStorage(ctx, info, bufferSize, isDepth);
 
-    if (!info->address)
-        info->address = glassVRAMAlloc(bufferSize, isDepth ? KYGX_ALLOC_VRAM_BANK_A : KYGX_ALLOC_VRAM_BANK_B);
+    if (!info->address && GLASS_vram_compact())
+        info->address = allocRenderbufferStorage(ctx, info, bufferSize, isDepth);
+
+    // Last resort: purge other objects.
+    if (!info->address && GLASS_budget_purge(ctx, true, bufferSize, GLASS_INVALID_OBJECT))
+        info->address = allocRenderbufferStorage(ctx, info, bufferSize, isDepth);
 
     if (!info->address) {
         GLASS_context_setError(GL_OUT_OF_MEMORY);
         return;
     }
 
+    if (!info->transient) {
+        GLASS_vram_track((GLuint)info);
+        GLASS_memStats_add(GLASS_MEMORY_RENDERBUFFERS, info->address, glassVRAMSize(info->address), (GLuint)info);
+    }
+
     info->width = width;
     info->height = height;
     info->format = internalformat;
-}
\ No newline at end of file
+    GLASS_invalidateFramebuffers();
+}
+
+void glRenderbufferTransientPICA(GLenum target, GLboolean transient) {
+    if (target != GL_RENDERBUFFER) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+
+    // Get renderbuffer.
+    if (!GLASS_OBJ_IS_RENDERBUFFER(ctx->renderbuffer)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    RenderbufferInfo* info = (RenderbufferInfo*)ctx->renderbuffer;
+    const bool isTransient = (transient == GL_TRUE);
+
+    // Storage has to be specified again.
+    if (info->transient != isTransient) {
+        freeRenderbufferStorage(info);
+        info->transient = isTransient;
+        ctx->flags |= GLASS_CONTEXT_FLAG_FRAMEBUFFER;
+    }
+}
+
+void glRenderbufferVRAMBankPICA(GLenum target, GLenum bank) {
+    if ((target != GL_RENDERBUFFER) || ((bank != GL_NONE) && (bank != GL_VRAM_BANK_A_PICA) && (bank != GL_VRAM_BANK_B_PICA))) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+
+    // Get renderbuffer.
+    if (!GLASS_OBJ_IS_RENDERBUFFER(ctx->renderbuffer)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    RenderbufferInfo* info = (RenderbufferInfo*)ctx->renderbuffer;
+    info->vramBank = bank;
+
+    // Existing data is moved at the end of the frame, when the GPU is idle.
+    if ((bank != GL_NONE) && !GLASS_residency_queueBankMove((GLuint)info))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+}
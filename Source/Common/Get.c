@@ -21,24 +21,29 @@ typedef struct {
     bool normalizeInt; // Normalize int between -MAX_INT...MAX_INT, only meaningful for floats.
 } Value;
 
-static inline GLint getFBColorSize(CtxCommon* ctx, GLenum color) {
+static inline GLenum getFBColorFormat(CtxCommon* ctx) {
     KYGX_ASSERT(ctx);
 
     const FramebufferInfo* fbInfo = (const FramebufferInfo*)ctx->framebuffer[GLASS_context_getFBIndex(ctx)];
     if (!fbInfo)
         return 0;
 
-    GLenum format = 0;
     if (GLASS_OBJ_IS_RENDERBUFFER(fbInfo->colorBuffer)) {
         const RenderbufferInfo* cbInfo = (const RenderbufferInfo*)fbInfo->colorBuffer;
-        format = cbInfo->format;
-    } else if (GLASS_OBJ_IS_TEXTURE(fbInfo->colorBuffer)) {
+        return cbInfo->format;
+    }
+
+    if (GLASS_OBJ_IS_TEXTURE(fbInfo->colorBuffer)) {
         RenderbufferInfo cb;
         GLASS_tex_getAsRenderbuffer((const TextureInfo*)fbInfo->colorBuffer, fbInfo->texFace, &cb);
-        format = cb.format;
+        return cb.format;
     }
 
-    switch (format) {
+    return 0;
+}
+
+static inline GLint getFBColorSize(CtxCommon* ctx, GLenum color) {
+    switch (getFBColorFormat(ctx)) {
         case GL_RGBA8_OES:
             return 8;
         case GL_RGB5_A1:
@@ -60,6 +65,22 @@ static inline GLint getFBColorSize(CtxCommon* ctx, GLenum color) {
     return 0;
 }
 
+// Read format/type pair that matches the color buffer, so no conversion is required.
+static inline GLenum getFBColorReadFormat(CtxCommon* ctx) { return (getFBColorFormat(ctx) == GL_RGB565) ? GL_RGB : GL_RGBA; }
+
+static inline GLenum getFBColorReadType(CtxCommon* ctx) {
+    switch (getFBColorFormat(ctx)) {
+        case GL_RGB5_A1:
+            return GL_UNSIGNED_SHORT_5_5_5_1;
+        case GL_RGB565:
+            return GL_UNSIGNED_SHORT_5_6_5;
+        case GL_RGBA4:
+            return GL_UNSIGNED_SHORT_4_4_4_4;
+        default:
+            return GL_UNSIGNED_BYTE;
+    }
+}
+
 static inline GLint getFBDepthBits(CtxCommon* ctx) {
     KYGX_ASSERT(ctx);
 
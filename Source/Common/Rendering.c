@@ -11,6 +11,7 @@
 #include "Base/TexManager.h"
 #include "Base/Math.h"
 #include "Base/Read.h"
+#include "Base/Residency.h"
 #include "Platform/GPU.h"
 
 #include <string.h> // memset
@@ -27,6 +28,12 @@
 extern GLenum glCheckFramebufferStatus(GLenum target);
 
 static inline bool checkFB(void) {
+    // Fast path: status cached by a previous check is still valid.
+    CtxCommon* ctx = GLASS_context_getBound();
+    const FramebufferInfo* info = (FramebufferInfo*)ctx->framebuffer[GLASS_context_getFBIndex(ctx)];
+    if (GLASS_OBJ_IS_FRAMEBUFFER((GLuint)info) && (info->statusEpoch == GLASS_getFramebufferEpoch()) && (info->status == GL_FRAMEBUFFER_COMPLETE))
+        return true;
+
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         GLASS_context_setError(GL_INVALID_FRAMEBUFFER_OPERATION);
         return false;
@@ -178,9 +185,17 @@ void glClear(GLbitfield mask) {
     }
 
     if (colorFill.addr || depthFill.addr) {
+        // Queued transfers keep the batch open, the fill is finalized along with them.
+        const bool batched = ctx->numQueuedCmds > 0;
+        if (batched)
+            GLASS_context_reserveTransfer(ctx, 1);
+
         kygxLock();
         kygxAddMemoryFill(&ctx->GXCmdBuf, &colorFill, &depthFill);
-        kygxCmdBufferFinalize(&ctx->GXCmdBuf, NULL, NULL);
+
+        if (!batched)
+            kygxCmdBufferFinalize(&ctx->GXCmdBuf, NULL, NULL);
+
         kygxUnlock(true);
     }
 }
@@ -215,6 +230,96 @@ static inline bool isDrawMode(GLenum mode) {
     return false;
 }
 
+// Tag buffers and textures used by the draw with the fence of the pending commands.
+static void fenceDrawBuffers(CtxCommon* ctx, bool elements) {
+    KYGX_ASSERT(ctx);
+
+    const u32 fence = GLASS_context_getPendingFence(ctx);
+
+    for (size_t i = 0; i < GLASS_NUM_ATTRIB_REGS; ++i) {
+        const AttributeInfo* attrib = &ctx->attribs[i];
+
+        if (!(attrib->flags & GLASS_ATTRIB_FLAG_ENABLED) || (attrib->flags & GLASS_ATTRIB_FLAG_FIXED))
+            continue;
+
+        if (attrib->boundBuffer != GLASS_INVALID_OBJECT)
+            ((BufferInfo*)attrib->boundBuffer)->fence = fence;
+    }
+
+    if (elements && (ctx->elementArrayBuffer != GLASS_INVALID_OBJECT))
+        ((BufferInfo*)ctx->elementArrayBuffer)->fence = fence;
+
+    for (size_t i = 0; i < GLASS_NUM_TEX_UNITS; ++i) {
+        if (ctx->textureUnits[i] != GLASS_INVALID_OBJECT)
+            ((TextureInfo*)ctx->textureUnits[i])->fence = fence;
+    }
+
+    // Textures are also written when rendered into.
+    const GLuint framebuffer = ctx->framebuffer[GLASS_context_getFBIndex(ctx)];
+    if (GLASS_OBJ_IS_FRAMEBUFFER(framebuffer)) {
+        const GLuint colorBuffer = ((FramebufferInfo*)framebuffer)->colorBuffer;
+        if (GLASS_OBJ_IS_TEXTURE(colorBuffer))
+            ((TextureInfo*)colorBuffer)->fence = fence;
+    }
+}
+
+// Pixels read into a pack buffer must land before the buffer is used as vertex or index data.
+static void resolveDrawBuffers(CtxCommon* ctx, bool elements) {
+    KYGX_ASSERT(ctx);
+
+    for (size_t i = 0; i < GLASS_NUM_ATTRIB_REGS; ++i) {
+        const AttributeInfo* attrib = &ctx->attribs[i];
+
+        if (!(attrib->flags & GLASS_ATTRIB_FLAG_ENABLED) || (attrib->flags & GLASS_ATTRIB_FLAG_FIXED))
+            continue;
+
+        if (attrib->boundBuffer != GLASS_INVALID_OBJECT)
+            GLASS_read_resolvePack((BufferInfo*)attrib->boundBuffer);
+    }
+
+    if (elements && (ctx->elementArrayBuffer != GLASS_INVALID_OBJECT))
+        GLASS_read_resolvePack((BufferInfo*)ctx->elementArrayBuffer);
+}
+
+static bool hasClientArrays(CtxCommon* ctx) {
+    KYGX_ASSERT(ctx);
+
+    for (size_t i = 0; i < GLASS_NUM_ATTRIB_REGS; ++i) {
+        const AttributeInfo* attrib = &ctx->attribs[i];
+
+        if ((attrib->flags & GLASS_ATTRIB_FLAG_ENABLED) && !(attrib->flags & GLASS_ATTRIB_FLAG_FIXED) && (attrib->boundBuffer == GLASS_INVALID_OBJECT))
+            return true;
+    }
+
+    return false;
+}
+
+// Client arrays are written by the application, only the draw knows how much data is read.
+static void markClientArrays(CtxCommon* ctx, size_t numVertices) {
+    KYGX_ASSERT(ctx);
+
+    for (size_t i = 0; i < GLASS_NUM_ATTRIB_REGS; ++i) {
+        const AttributeInfo* attrib = &ctx->attribs[i];
+
+        if (!(attrib->flags & GLASS_ATTRIB_FLAG_ENABLED) || (attrib->flags & GLASS_ATTRIB_FLAG_FIXED))
+            continue;
+
+        if ((attrib->boundBuffer == GLASS_INVALID_OBJECT) && attrib->physAddr)
+            GLASS_context_markDirty(ctx, kygxGetVirtualAddress(attrib->physAddr), numVertices * attrib->bufferSize);
+    }
+}
+
+static size_t getNumIndexedVertices(const GLvoid* indices, GLsizei count, GLenum type) {
+    size_t maxIndex = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const size_t index = (type == GL_UNSIGNED_BYTE) ? ((const u8*)indices)[i] : ((const u16*)indices)[i];
+        maxIndex = GLASS_MAX(maxIndex, index);
+    }
+
+    return count ? (maxIndex + 1) : 0;
+}
+
 void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
     if (!isDrawMode(mode)) {
         GLASS_context_setError(GL_INVALID_ENUM);
@@ -231,7 +336,11 @@ void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
 
     // Apply prior commands.
     CtxCommon* ctx = GLASS_context_getBound();
+    resolveDrawBuffers(ctx, false);
     GLASS_context_flush(ctx, false);
+    fenceDrawBuffers(ctx, false);
+    markClientArrays(ctx, first + count);
+    GLASS_residency_noteDraw(ctx, count);
 
     // Add draw command.
     GLASS_gpu_drawArrays(&ctx->params.GPUCmdList, mode, first, count);
@@ -259,18 +368,28 @@ void glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indic
 
     // Get physical address.
     CtxCommon* ctx = GLASS_context_getBound();
+    resolveDrawBuffers(ctx, true);
+
+    const GLvoid* indexData = indices;
     u32 physAddr = 0;
     if (ctx->elementArrayBuffer != GLASS_INVALID_OBJECT) {
         const BufferInfo* binfo = (BufferInfo*)ctx->elementArrayBuffer;
-        physAddr = kygxGetPhysicalAddress((void*)(binfo->address + (u32)indices));
+        indexData = binfo->address + (u32)indices;
+        physAddr = kygxGetPhysicalAddress(indexData);
     } else {
         physAddr = kygxGetPhysicalAddress(indices);
+        GLASS_context_markDirty(ctx, indices, count * ((type == GL_UNSIGNED_BYTE) ? 1 : 2));
     }
 
     KYGX_ASSERT(physAddr);
 
+    if (!ctx->params.flushAllLinearMem && hasClientArrays(ctx))
+        markClientArrays(ctx, getNumIndexedVertices(indexData, count, type));
+
     // Apply prior commands.
     GLASS_context_flush(ctx, false);
+    fenceDrawBuffers(ctx, true);
+    GLASS_residency_noteDraw(ctx, count);
 
     // Add draw command.
     GLASS_gpu_drawElements(&ctx->params.GPUCmdList, mode, count, type, physAddr);
@@ -307,6 +426,35 @@ static inline bool isReadType(GLenum type) {
     }
 }
 
+static bool tryUnwrapReadFormat(GLenum format, GLenum type, RIPPixelFormat* out) {
+    if (format == GL_RGBA) {
+        switch (type) {
+            case GL_UNSIGNED_BYTE:
+                *out = RIP_PIXELFORMAT_RGBA8;
+                return true;
+            case GL_UNSIGNED_SHORT_4_4_4_4:
+                *out = RIP_PIXELFORMAT_RGBA4;
+                return true;
+            case GL_UNSIGNED_SHORT_5_5_5_1:
+                *out = RIP_PIXELFORMAT_RGB5A1;
+                return true;
+        }
+    }
+
+    if (format == GL_RGB) {
+        switch (type) {
+            case GL_UNSIGNED_BYTE:
+                *out = RIP_PIXELFORMAT_RGB8;
+                return true;
+            case GL_UNSIGNED_SHORT_5_6_5:
+                *out = RIP_PIXELFORMAT_RGB565;
+                return true;
+        }
+    }
+
+    return false;
+}
+
 void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* data) {
     if (!isReadFormat(format) || !isReadType(type)) {
         GLASS_context_setError(GL_INVALID_ENUM);
@@ -328,8 +476,8 @@ void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format
         return;
     }
 
-    // We could support one more pair.
-    if (format != GL_RGBA || type != GL_UNSIGNED_BYTE) {
+    RIPPixelFormat pixelFormat;
+    if (!tryUnwrapReadFormat(format, type, &pixelFormat)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
@@ -341,5 +489,23 @@ void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format
     CtxCommon* ctx = GLASS_context_getBound();
     const FramebufferInfo* fbInfo = (const FramebufferInfo*)ctx->framebuffer[GLASS_context_getFBIndex(ctx)];
 
-    GLASS_read_colorBuffer(fbInfo, x, y, width, height, RIP_PIXELFORMAT_RGBA8, data);
+    if (ctx->pixelPackBuffer == GLASS_INVALID_OBJECT) {
+        if (!GLASS_read_colorBuffer(fbInfo, x, y, width, height, pixelFormat, data))
+            GLASS_context_setError(GL_OUT_OF_MEMORY);
+
+        return;
+    }
+
+    // With a pack buffer, data is an offset and the read completes when the buffer is accessed.
+    BufferInfo* pack = (BufferInfo*)ctx->pixelPackBuffer;
+    const size_t offset = (size_t)data;
+    const size_t lineSize = width * (ripGetPixelFormatBPP(pixelFormat) >> 3);
+    const size_t readSize = height ? ((kygxAlignUp(lineSize, ctx->packAlignment) * (height - 1)) + lineSize) : 0;
+    if (!pack->address || pack->mapAccess || glassIsVRAM(pack->address) || (offset > pack->size) || (readSize > (pack->size - offset))) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    if (!GLASS_read_queuePack(pack, offset, fbInfo, x, y, width, height, pixelFormat))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
  */
 #include "Base/Context.h"
 #include "Base/Math.h"
+#include "Base/MemStats.h"
 
 #include <string.h> // strlen, memset, memcpy
 
@@ -100,6 +101,15 @@ static void freeUniformData(ShaderInfo* shader) {
     glassHeapFree(shader->activeUniforms);
 }
 
+static inline size_t getSharedDataSize(const SharedShaderData* sharedData) {
+    return sizeof(SharedShaderData) + (sharedData->numOfCodeWords * sizeof(u32)) + (sharedData->numOfOpDescs * sizeof(u32));
+}
+
+static inline void freeSharedData(SharedShaderData* sharedData) {
+    GLASS_memStats_remove(GLASS_MEMORY_SHADERS, sharedData, getSharedDataSize(sharedData));
+    glassHeapFree(sharedData);
+}
+
 static inline void decSharedDataRefc(SharedShaderData* sharedData) {
     KYGX_ASSERT(sharedData);
 
@@ -107,7 +117,7 @@ static inline void decSharedDataRefc(SharedShaderData* sharedData) {
         --sharedData->refc;
 
     if (!sharedData->refc)
-        glassHeapFree(sharedData);
+        freeSharedData(sharedData);
 }
 
 static inline void decShaderRefc(ShaderInfo* shader) {
@@ -123,7 +133,7 @@ static inline void decShaderRefc(ShaderInfo* shader) {
             decSharedDataRefc(shader->sharedData);
 
         freeUniformData(shader);
-        glassHeapFree(shader);
+        GLASS_destroyObject((GLuint)shader);
     }
 }
 
@@ -168,7 +178,7 @@ static void freeProgram(ProgramInfo* info) {
     if (GLASS_OBJ_IS_SHADER(info->linkedGeometry))
         decShaderRefc((ShaderInfo*)info->linkedGeometry);
 
-    glassHeapFree(info);
+    GLASS_destroyObject((GLuint)info);
 }
 
 static inline size_t numActiveUniforms(const ProgramInfo* info) {
@@ -253,7 +263,7 @@ static bool lookupShader(const GLuint* shaders, size_t maxShaders, size_t index,
     KYGX_ASSERT(out);
 
     for (size_t i = index; i < maxShaders; ++i) {
-        GLuint name = shaders[i];
+        GLuint name = GLASS_getObject(shaders[i], GLASS_SHADER_TYPE);
         KYGX_ASSERT(GLASS_OBJ_IS_SHADER(name));
 
         const ShaderInfo* shader = (const ShaderInfo*)name;
@@ -334,6 +344,9 @@ static SharedShaderData* parseDVLP(const u8* data, size_t size) {
         // Read op descs.
         for (size_t i = 0; i < sharedData->numOfOpDescs; ++i)
             sharedData->opDescs[i] = ((u32*)(data + offsetToOpDescs))[i * 2];
+
+        // Shared between shaders, no single owner.
+        GLASS_memStats_add(GLASS_MEMORY_SHADERS, sharedData, getSharedDataSize(sharedData), GLASS_INVALID_OBJECT);
     }
 
     return sharedData;
@@ -730,7 +743,10 @@ static bool loadUniforms(const DVLEInfo* info, ShaderInfo* out) {
     return true;
 }
 
-void glAttachShader(GLuint program, GLuint shader) {
+void glAttachShader(GLuint programName, GLuint shaderName) {
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+    const GLuint shader = GLASS_getObject(shaderName, GLASS_SHADER_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program) || !GLASS_OBJ_IS_SHADER(shader)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -772,7 +788,7 @@ GLuint glCreateProgram(void) {
         info->gsPermutations[0] = 0x76543210;
         info->gsPermutations[1] = 0xFEDCBA98;
         info->flags = 0;
-        return name;
+        return GLASS_getObjectName(name);
     }
 
     GLASS_context_setError(GL_OUT_OF_MEMORY);
@@ -799,18 +815,20 @@ GLuint glCreateShader(GLenum shaderType) {
         ShaderInfo* info = (ShaderInfo*)name;
         info->flags = flags;
         info->refc = 1;
-        return name;
+        return GLASS_getObjectName(name);
     }
 
     GLASS_context_setError(GL_OUT_OF_MEMORY);
     return GLASS_INVALID_OBJECT;
 }
 
-void glDeleteProgram(GLuint program) {
+void glDeleteProgram(GLuint name) {
     // A value of 0 is silently ignored.
-    if (program == GLASS_INVALID_OBJECT)
+    if (name == GLASS_INVALID_OBJECT)
         return;
 
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_VALUE);
         return;
@@ -827,11 +845,13 @@ void glDeleteProgram(GLuint program) {
     }
 }
 
-void glDeleteShader(GLuint shader) {
+void glDeleteShader(GLuint name) {
     // A value of 0 is silently ignored.
-    if (shader == GLASS_INVALID_OBJECT)
+    if (name == GLASS_INVALID_OBJECT)
         return;
 
+    const GLuint shader = GLASS_getObject(name, GLASS_SHADER_TYPE);
+
     if (!GLASS_OBJ_IS_SHADER(shader)) {
         GLASS_context_setError(GL_INVALID_VALUE);
         return;
@@ -846,7 +866,10 @@ void glDeleteShader(GLuint shader) {
     }
 }
 
-void glDetachShader(GLuint program, GLuint shader) {
+void glDetachShader(GLuint programName, GLuint shaderName) {
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+    const GLuint shader = GLASS_getObject(shaderName, GLASS_SHADER_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program) || !GLASS_OBJ_IS_SHADER(shader)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -857,9 +880,11 @@ void glDetachShader(GLuint program, GLuint shader) {
     detachFromProgram(pinfo, sinfo);
 }
 
-void glGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders) {
+void glGetAttachedShaders(GLuint name, GLsizei maxCount, GLsizei* count, GLuint* shaders) {
     KYGX_ASSERT(shaders);
 
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
+
     GLsizei shaderCount = 0;
 
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
@@ -877,12 +902,12 @@ void glGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLui
     // Get shaders.
     if (shaderCount < maxCount) {
         if (GLASS_OBJ_IS_SHADER(info->attachedVertex))
-            shaders[shaderCount++] = info->attachedVertex;
+            shaders[shaderCount++] = GLASS_getObjectName(info->attachedVertex);
     }
 
     if (shaderCount < maxCount) {
         if (GLASS_OBJ_IS_SHADER(info->attachedGeometry))
-            shaders[shaderCount++] = info->attachedGeometry;
+            shaders[shaderCount++] = GLASS_getObjectName(info->attachedGeometry);
     }
 
     // Get count.
@@ -890,9 +915,11 @@ void glGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLui
         *count = shaderCount;
 }
 
-void glGetProgramiv(GLuint program, GLenum pname, GLint* params) {
+void glGetProgramiv(GLuint name, GLenum pname, GLint* params) {
     KYGX_ASSERT(params);
 
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -940,9 +967,11 @@ void glGetProgramiv(GLuint program, GLenum pname, GLint* params) {
     }
 }
 
-void glGetShaderiv(GLuint shader, GLenum pname, GLint* params) {
+void glGetShaderiv(GLuint name, GLenum pname, GLint* params) {
     KYGX_ASSERT(params);
 
+    const GLuint shader = GLASS_getObject(name, GLASS_SHADER_TYPE);
+
     if (!GLASS_OBJ_IS_SHADER(shader)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -968,10 +997,12 @@ void glGetShaderiv(GLuint shader, GLenum pname, GLint* params) {
     }
 }
 
-GLboolean glIsProgram(GLuint program) { return GLASS_OBJ_IS_PROGRAM(program) ? GL_TRUE : GL_FALSE; }
-GLboolean glIsShader(GLuint shader) { return GLASS_OBJ_IS_SHADER(shader) ? GL_TRUE : GL_FALSE; }
+GLboolean glIsProgram(GLuint program) { return GLASS_OBJ_IS_PROGRAM(GLASS_getObject(program, GLASS_PROGRAM_TYPE)) ? GL_TRUE : GL_FALSE; }
+GLboolean glIsShader(GLuint shader) { return GLASS_OBJ_IS_SHADER(GLASS_getObject(shader, GLASS_SHADER_TYPE)) ? GL_TRUE : GL_FALSE; }
+
+void glLinkProgram(GLuint name) {
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
 
-void glLinkProgram(GLuint program) {
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -1050,7 +1081,7 @@ void glShaderBinary(GLsizei n, const GLuint* shaders, GLenum binaryformat, const
     }
 
     for (size_t i = 0; i < n; ++i) {
-        if (!GLASS_OBJ_IS_SHADER(shaders[i])) {
+        if (!GLASS_OBJ_IS_SHADER(GLASS_getObject(shaders[i], GLASS_SHADER_TYPE))) {
             GLASS_context_setError(GL_INVALID_VALUE);
             return;
         }
@@ -1090,7 +1121,7 @@ void glShaderBinary(GLsizei n, const GLuint* shaders, GLenum binaryformat, const
             continue;
 
         // Setup shader.
-        ShaderInfo* shader = (ShaderInfo*)shaders[index];
+        ShaderInfo* shader = (ShaderInfo*)GLASS_getObject(shaders[index], GLASS_SHADER_TYPE);
         if (info.gsMergeOutmaps) {
             KYGX_ASSERT(info.isGeometry);
             shader->flags |= GLASS_SHADER_FLAG_MERGE_OUTMAPS;
@@ -1152,13 +1183,15 @@ void glShaderBinary(GLsizei n, const GLuint* shaders, GLenum binaryformat, const
 glShaderBinary_freeRes:
     // Free resources.
     if (sharedData && !sharedData->refc)
-        glassHeapFree(sharedData);
+        freeSharedData(sharedData);
 
     glassHeapFree(dvlb);
 }
 
-void glUseProgram(GLuint program) {
-    if (!GLASS_OBJ_IS_PROGRAM(program) && (program != GLASS_INVALID_OBJECT)) {
+void glUseProgram(GLuint name) {
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
+
+    if (!GLASS_OBJ_IS_PROGRAM(program) && (name != GLASS_INVALID_OBJECT)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
@@ -1186,7 +1219,9 @@ void glUseProgram(GLuint program) {
     }
 }
 
-void glProgramGeometryStridePICA(GLuint program, GLuint stride) {
+void glProgramGeometryStridePICA(GLuint name, GLuint stride) {
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -1206,7 +1241,9 @@ void glProgramGeometryStridePICA(GLuint program, GLuint stride) {
     }
 }
 
-void glProgramGeometryPermutationsPICA(GLuint program, const GLuint* permutations) {
+void glProgramGeometryPermutationsPICA(GLuint name, const GLuint* permutations) {
+    const GLuint program = GLASS_getObject(name, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
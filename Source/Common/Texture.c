@@ -7,11 +7,16 @@
 #include <KYGX/Utility.h>
 #include <RIP/Texture.h>
 
+#include "Base/Budget.h"
+#include "Base/BufferPool.h"
 #include "Base/Context.h"
+#include "Base/Residency.h"
 #include "Base/TexManager.h"
+#include "Base/VRAM.h"
 
-void glBindTexture(GLenum target, GLuint name) {
-    KYGX_ASSERT(GLASS_OBJ_IS_TEXTURE(name) || name == GLASS_INVALID_OBJECT);
+void glBindTexture(GLenum target, GLuint texture) {
+    const GLuint name = GLASS_getObject(texture, GLASS_TEXTURE_TYPE);
+    KYGX_ASSERT(GLASS_OBJ_IS_TEXTURE(name) || texture == GLASS_INVALID_OBJECT);
 
     if ((target != GL_TEXTURE_2D) && (target != GL_TEXTURE_CUBE_MAP)) {
         GLASS_context_setError(GL_INVALID_ENUM);
@@ -55,7 +60,7 @@ void glDeleteTextures(GLsizei n, const GLuint* textures) {
     CtxCommon* ctx = GLASS_context_getBound();
 
     for (size_t i = 0; i < n; ++i) {
-        GLuint name = textures[i];
+        GLuint name = GLASS_getObject(textures[i], GLASS_TEXTURE_TYPE);
 
         // Validate name.
         if (!GLASS_OBJ_IS_TEXTURE(name))
@@ -79,12 +84,10 @@ void glDeleteTextures(GLsizei n, const GLuint* textures) {
         }
 
         // Delete texture.
-        for (size_t j = 0; j < GLASS_NUM_TEX_FACES; ++j) {
-            u8* p = tex->faces[j];
-            tex->vram ? glassVRAMFree(p) : glassLinearFree(p);
-        }
-
-        glassHeapFree(tex);
+        GLASS_residency_forget(tex);
+        GLASS_budget_setPurgeable(name, false);
+        GLASS_tex_freeData(tex);
+        GLASS_destroyObject(name);
     }
 }
 
@@ -110,13 +113,14 @@ void glGenTextures(GLsizei n, GLuint* textures) {
         tex->magFilter = GL_LINEAR;
         tex->wrapS = GL_REPEAT;
         tex->wrapT = GL_REPEAT;
-        textures[i] = name;
+        textures[i] = GLASS_getObjectName(name);
     }
 }
 
 GLboolean glIsTexture(GLuint texture) {
-    if (GLASS_OBJ_IS_TEXTURE(texture)) {
-        const TextureInfo* tex = (TextureInfo*)texture;
+    const GLuint name = GLASS_getObject(texture, GLASS_TEXTURE_TYPE);
+    if (GLASS_OBJ_IS_TEXTURE(name)) {
+        const TextureInfo* tex = (TextureInfo*)name;
         if (tex->target != GLASS_TEX_TARGET_UNBOUND)
             return GL_TRUE;
     }
@@ -348,6 +352,57 @@ static inline GLenum texTargetForSubtarget(GLenum target) {
     KYGX_UNREACHABLE("Invalid parameter!");
 }
 
+// Texture bound to the active unit for a texture image target, sets an error on failure.
+static TextureInfo* getTargetTexture(CtxCommon* ctx, GLenum target, size_t* face) {
+    TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
+
+    // We don't support default textures.
+    if (!tex) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return NULL;
+    }
+
+    // Target check.
+    if (tex->target != texTargetForSubtarget(target)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return NULL;
+    }
+
+    // Only texture0 supports cube maps.
+    const bool hasCubeMap = (target != GL_TEXTURE_2D);
+    if (hasCubeMap && ctx->activeTextureUnit) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return NULL;
+    }
+
+    switch (target) {
+        case GL_TEXTURE_2D:
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+            *face = 0;
+            break;
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+            *face = 1;
+            break;
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+            *face = 2;
+            break;
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+            *face = 3;
+            break;
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+            *face = 4;
+            break;
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+            *face = 5;
+            break;
+        default:
+            GLASS_context_setError(GL_INVALID_ENUM);
+            return NULL;
+    }
+
+    return tex;
+}
+
 static bool tryUnwrapTexFormat(GLenum format, GLenum type, GPUTexFormat* out) {
     if (format == GL_ALPHA) {
         if (type == GL_UNSIGNED_BYTE) {
@@ -442,6 +497,76 @@ static bool tryUnwrapTexFormat(GLenum format, GLenum type, GPUTexFormat* out) {
     return false;
 }
 
+// RGB(A) bytes that are stored in a smaller format.
+static bool tryUnwrapConvertedFormat(GLint internalformat, GLenum format, GLenum type, GPUTexFormat* out) {
+    if (type != GL_UNSIGNED_BYTE)
+        return false;
+
+    switch (internalformat) {
+        case GL_RGBA4:
+            *out = TEXFORMAT_RGBA4;
+            return format == GL_RGBA;
+        case GL_RGB5_A1:
+            *out = TEXFORMAT_RGB5A1;
+            return format == GL_RGBA;
+        case GL_RGB565:
+            *out = TEXFORMAT_RGB565;
+            return format == GL_RGB;
+        case GL_COMPACT_FORMAT_PICA:
+            // Picked once the data is known.
+            *out = (format == GL_RGBA) ? TEXFORMAT_RGBA8 : TEXFORMAT_RGB8;
+            return (format == GL_RGB) || (format == GL_RGBA);
+    }
+
+    return false;
+}
+
+static inline bool isCompactFormat(GPUTexFormat format) {
+    switch (format) {
+        case TEXFORMAT_RGBA8:
+        case TEXFORMAT_RGB8:
+        case TEXFORMAT_LA8:
+        case TEXFORMAT_L8:
+        case TEXFORMAT_A8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Smallest format that stores the image without loss.
+static GPUTexFormat getCompactFormat(const u8* data, size_t width, size_t height, size_t components) {
+    bool gray = true;
+    bool black = true;
+    bool opaque = true;
+
+    for (size_t i = 0; i < (width * height); ++i) {
+        const u8* pixel = &data[i * components];
+
+        if ((pixel[0] != pixel[1]) || (pixel[1] != pixel[2]))
+            gray = false;
+
+        if (pixel[0] || pixel[1] || pixel[2])
+            black = false;
+
+        if ((components == 4) && (pixel[3] != 0xFF))
+            opaque = false;
+
+        if (!gray && !opaque)
+            break;
+    }
+
+    if (gray) {
+        if (opaque)
+            return TEXFORMAT_L8;
+
+        // Alpha textures sample as black.
+        return black ? TEXFORMAT_A8 : TEXFORMAT_LA8;
+    }
+
+    return opaque ? TEXFORMAT_RGB8 : TEXFORMAT_RGBA8;
+}
+
 void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* data) {
     if (!checkTexArgs(target, level, width, height, border)) {
         GLASS_context_setError(GL_INVALID_VALUE);
@@ -453,60 +578,236 @@ void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei widt
         return;
     }
 
+    // RGB(A) data can be compressed or converted on upload by requesting a different internal format.
+    size_t encodeComponents = 0;
+    size_t convertComponents = 0;
     GPUTexFormat nativeFormat;
-    if (format != internalformat || !tryUnwrapTexFormat(format, type, &nativeFormat)) {
+    if ((internalformat == GL_ETC1_RGB8_OES) || (internalformat == GL_ETC1_ALPHA_RGB8_A4_PICA)) {
+        if (((format != GL_RGB) && (format != GL_RGBA)) || (type != GL_UNSIGNED_BYTE)) {
+            GLASS_context_setError(GL_INVALID_OPERATION);
+            return;
+        }
+
+        encodeComponents = (format == GL_RGBA) ? 4 : 3;
+        nativeFormat = (internalformat == GL_ETC1_RGB8_OES) ? TEXFORMAT_ETC1 : TEXFORMAT_ETC1A4;
+    } else if (internalformat != (GLint)format) {
+        if (!tryUnwrapConvertedFormat(internalformat, format, type, &nativeFormat)) {
+            GLASS_context_setError(GL_INVALID_OPERATION);
+            return;
+        }
+
+        convertComponents = (format == GL_RGBA) ? 4 : 3;
+    } else if (!tryUnwrapTexFormat(format, type, &nativeFormat)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
 
+    CtxCommon* ctx = GLASS_context_getBound();
+    size_t face;
+    TextureInfo* tex = getTargetTexture(ctx, target, &face);
+    if (!tex)
+        return;
+
+    // The format is picked from the base level, other levels follow it.
+    if (internalformat == GL_COMPACT_FORMAT_PICA) {
+        if (!data) {
+            GLASS_context_setError(GL_INVALID_OPERATION);
+            return;
+        }
+
+        if (level && tex->faces[0] && isCompactFormat(tex->format)) {
+            nativeFormat = tex->format;
+        } else {
+            nativeFormat = getCompactFormat(data, width, height, convertComponents);
+        }
+    }
+
+    // Prepare memory.
+    TexReallocStatus reallocStatus = GLASS_tex_realloc(tex, width << level, height << level, nativeFormat, tex->vram);
+    if (reallocStatus == TEXREALLOCSTATUS_FAILED)
+        return;
+
+    // Write data.
+    if (data) {
+        if (encodeComponents) {
+            GLASS_tex_writeEncoded(tex, data, face, level, encodeComponents);
+        } else if (convertComponents) {
+            GLASS_tex_writeConverted(tex, data, face, level, convertComponents);
+        } else {
+            GLASS_tex_writeUntiled(tex, data, face, level);
+        }
+
+        reallocStatus = TEXREALLOCSTATUS_UPDATED;
+    }
+    
+    if (reallocStatus == TEXREALLOCSTATUS_UPDATED)
+        ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;   
+}
+
+void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* data) {
+    if (!isTexFormat(format) || !isTexType(type)) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    if (level < 0 || level >= GLASS_NUM_TEX_LEVELS) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    if (xoffset < 0 || yoffset < 0 || width < 0 || height < 0) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    GPUTexFormat nativeFormat;
+    if (!tryUnwrapTexFormat(format, type, &nativeFormat)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    size_t face;
+    TextureInfo* tex = getTargetTexture(ctx, target, &face);
+    if (!tex)
+        return;
+
+    // The texture must have been previously allocated.
+    if (!tex->faces[face] || nativeFormat != tex->format) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // Check bounds.
+    if ((xoffset + width) > (tex->width >> level) || (yoffset + height) > (tex->height >> level)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    // Tiles can't be addressed below a byte per pixel.
+    if ((nativeFormat == TEXFORMAT_L4) || (nativeFormat == TEXFORMAT_A4)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
+
+    // Nothing to do.
+    if (!width || !height || !data)
+        return;
+
+    GLASS_tex_writeUntiledRect(tex, data, face, level, xoffset, yoffset, width, height);
+    ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
+}
+
+void glTexVRAMPICA(GLboolean enabled) {
     CtxCommon* ctx = GLASS_context_getBound();
     TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
 
-    // We don't support default textures.
     if (!tex) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
 
-    // Target check.
-    if (tex->target != texTargetForSubtarget(target)) {
+    // Transient textures are always in VRAM.
+    if (tex->transient)
+        return;
+
+    tex->manualVRAM = true;
+
+    const TexReallocStatus reallocStatus = GLASS_tex_realloc(tex, tex->width, tex->height, tex->format, enabled);
+    KYGX_ASSERT(reallocStatus != TEXREALLOCSTATUS_FAILED);
+
+    if (reallocStatus == TEXREALLOCSTATUS_UPDATED) {
+        tex->vram = enabled;
+        ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
+    }
+}
+
+void glTexPurgeablePICA(GLboolean purgeable) {
+    CtxCommon* ctx = GLASS_context_getBound();
+    const GLuint tex = ctx->textureUnits[ctx->activeTextureUnit];
+
+    if (!tex) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
 
-    // Only texture0 supports cube maps.
-    const bool hasCubeMap = (target != GL_TEXTURE_2D);
-    if (hasCubeMap && ctx->activeTextureUnit) {
+    if (!GLASS_budget_setPurgeable(tex, purgeable))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+}
+
+void glTexTransientPICA(GLboolean transient) {
+    CtxCommon* ctx = GLASS_context_getBound();
+    TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
+
+    // Only 2D textures can be render targets.
+    if (!tex || (tex->target != GL_TEXTURE_2D)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
-    
-    size_t face;
-    switch (target) {
-        case GL_TEXTURE_2D:
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
-            face = 0;
-            break;
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
-            face = 1;
-            break;
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
-            face = 2;
-            break;
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
-            face = 3;
-            break;
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
-            face = 4;
-            break;
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
-            face = 5;
-            break;
-        default:
-            GLASS_context_setError(GL_INVALID_ENUM);
-            return;
+
+    const bool isTransient = (transient == GL_TRUE);
+
+    // Image has to be specified again.
+    if (tex->transient != isTransient) {
+        GLASS_tex_freeData(tex);
+        tex->transient = isTransient;
+        tex->vram = isTransient;
+        ctx->flags |= (GLASS_CONTEXT_FLAG_TEXTURE | GLASS_CONTEXT_FLAG_FRAMEBUFFER);
+    }
+}
+
+void glTexVRAMBankPICA(GLenum bank) {
+    if ((bank != GL_NONE) && (bank != GL_VRAM_BANK_A_PICA) && (bank != GL_VRAM_BANK_B_PICA)) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
+
+    if (!tex) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
     }
 
+    tex->vramBank = bank;
+
+    // Existing data is moved at the end of the frame, when the GPU is idle.
+    if ((bank != GL_NONE) && !GLASS_residency_queueBankMove((GLuint)tex))
+        GLASS_context_setError(GL_OUT_OF_MEMORY);
+}
+
+static inline size_t getCompressedSize(GPUTexFormat format, GLsizei width, GLsizei height) {
+    // ETC1 takes 4 bits per pixel, ETC1A4 takes 8.
+    return (format == TEXFORMAT_ETC1A4) ? (width * height) : ((width * height) >> 1);
+}
+
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid* data) {
+    if (!checkTexArgs(target, level, width, height, border)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    if ((internalformat != GL_ETC1_RGB8_OES) && (internalformat != GL_ETC1_ALPHA_RGB8_A4_PICA)) {
+        GLASS_context_setError(GL_INVALID_ENUM);
+        return;
+    }
+
+    GPUTexFormat nativeFormat;
+    if (!tryUnwrapTexFormat(internalformat, GL_NONE, &nativeFormat))
+        KYGX_UNREACHABLE("Invalid format!");
+
+    if (imageSize != getCompressedSize(nativeFormat, width, height)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    CtxCommon* ctx = GLASS_context_getBound();
+    size_t face;
+    TextureInfo* tex = getTargetTexture(ctx, target, &face);
+    if (!tex)
+        return;
+
     // Prepare memory.
     TexReallocStatus reallocStatus = GLASS_tex_realloc(tex, width << level, height << level, nativeFormat, tex->vram);
     if (reallocStatus == TEXREALLOCSTATUS_FAILED)
@@ -517,18 +818,13 @@ void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei widt
         GLASS_tex_writeUntiled(tex, data, face, level);
         reallocStatus = TEXREALLOCSTATUS_UPDATED;
     }
-    
+
     if (reallocStatus == TEXREALLOCSTATUS_UPDATED)
-        ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;   
+        ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
 }
 
-void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* data) {
-    // TODO: test.
-    GLASS_context_setError(GL_INVALID_OPERATION);
-    return;
-    
-/*
-    if (!isTexFormat(format) || !isTexType(type)) {
+void glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid* data) {
+    if ((format != GL_ETC1_RGB8_OES) && (format != GL_ETC1_ALPHA_RGB8_A4_PICA)) {
         GLASS_context_setError(GL_INVALID_ENUM);
         return;
     }
@@ -544,106 +840,207 @@ void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, G
     }
 
     GPUTexFormat nativeFormat;
-    if (!tryUnwrapTexFormat(format, type, &nativeFormat)) {
-        GLASS_context_setError(GL_INVALID_OPERATION);
+    if (!tryUnwrapTexFormat(format, GL_NONE, &nativeFormat))
+        KYGX_UNREACHABLE("Invalid format!");
+
+    if (imageSize != getCompressedSize(nativeFormat, width, height)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
         return;
     }
 
     CtxCommon* ctx = GLASS_context_getBound();
-    TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
+    size_t face;
+    TextureInfo* tex = getTargetTexture(ctx, target, &face);
+    if (!tex)
+        return;
 
-    // We don't support default textures.
-    if (!tex) {
+    // The texture must have been previously allocated.
+    if (!tex->faces[face] || nativeFormat != tex->format) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
 
-    // Target check.
-    if (tex->target != texTargetForSubtarget(target)) {
-        GLASS_context_setError(GL_INVALID_OPERATION);
+    // Check bounds.
+    if ((xoffset + width) > (tex->width >> level) || (yoffset + height) > (tex->height >> level)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
         return;
     }
 
-    // Only texture0 supports cube maps.
-    const bool hasCubeMap = (target != GL_TEXTURE_2D);
-    if (hasCubeMap && ctx->activeTextureUnit) {
+    // Only whole tiles can be replaced.
+    if (!kygxIsAligned(xoffset, 8) || !kygxIsAligned(yoffset, 8) || !kygxIsAligned(width, 8) || !kygxIsAligned(height, 8)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
-    
-    size_t face;
-    switch (target) {
-        case GL_TEXTURE_2D:
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
-            face = 0;
+
+    // Nothing to do.
+    if (!width || !height || !data)
+        return;
+
+    GLASS_tex_writeCompressedRect(tex, data, face, level, xoffset, yoffset, width, height);
+    ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
+}
+
+extern GLenum glCheckFramebufferStatus(GLenum target);
+
+// Color buffer of the bound framebuffer, textures are viewed as renderbuffers.
+static bool getReadColorBuffer(CtxCommon* ctx, RenderbufferInfo* out) {
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        GLASS_context_setError(GL_INVALID_FRAMEBUFFER_OPERATION);
+        return false;
+    }
+
+    const FramebufferInfo* fb = (const FramebufferInfo*)ctx->framebuffer[GLASS_context_getFBIndex(ctx)];
+
+    if (GLASS_OBJ_IS_RENDERBUFFER(fb->colorBuffer)) {
+        *out = *(const RenderbufferInfo*)fb->colorBuffer;
+        return true;
+    }
+
+    if (GLASS_OBJ_IS_TEXTURE(fb->colorBuffer)) {
+        GLASS_tex_getAsRenderbuffer((const TextureInfo*)fb->colorBuffer, fb->texFace, out);
+        return true;
+    }
+
+    GLASS_context_setError(GL_INVALID_OPERATION);
+    return false;
+}
+
+// Copies are made of whole tiles that lie inside the color buffer.
+static inline bool checkCopyRect(const RenderbufferInfo* cb, GLint x, GLint y, GLsizei width, GLsizei height) {
+    if ((x < 0) || (y < 0) || !kygxIsAligned(x, 8) || !kygxIsAligned(y, 8))
+        return false;
+
+    if (!kygxIsAligned(width, 8) || !kygxIsAligned(height, 8))
+        return false;
+
+    return ((x + width) <= cb->width) && ((y + height) <= cb->height);
+}
+
+static bool tryUnwrapCopyFormat(GLenum internalformat, GLenum cbFormat, GPUTexFormat* out) {
+    switch (internalformat) {
+        case GL_RGBA:
+            *out = TEXFORMAT_RGBA8;
             break;
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
-            face = 1;
+        case GL_RGB:
+            *out = TEXFORMAT_RGB8;
             break;
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
-            face = 2;
+        case GL_RGBA4:
+            *out = TEXFORMAT_RGBA4;
             break;
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
-            face = 3;
+        case GL_RGB5_A1:
+            *out = TEXFORMAT_RGB5A1;
             break;
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
-            face = 4;
+        case GL_RGB565:
+            *out = TEXFORMAT_RGB565;
             break;
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
-            face = 5;
+        default:
+            return false;
+    }
+
+    // Alpha can't be made up.
+    return (cbFormat != GL_RGB565) || (*out == TEXFORMAT_RGB8) || (*out == TEXFORMAT_RGB565);
+}
+
+void glCopyTexImage2D(GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border) {
+    if (!checkTexArgs(target, level, width, height, border)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    switch (internalformat) {
+        case GL_ALPHA:
+        case GL_LUMINANCE:
+        case GL_LUMINANCE_ALPHA:
+        case GL_RGB:
+        case GL_RGBA:
+        case GL_RGBA4:
+        case GL_RGB5_A1:
+        case GL_RGB565:
             break;
         default:
             GLASS_context_setError(GL_INVALID_ENUM);
             return;
     }
 
-    // Check bounds.
-    if ((xoffset + width) > tex->width || (yoffset + height) > tex->height) {
-        GLASS_context_setError(GL_INVALID_VALUE);
+    CtxCommon* ctx = GLASS_context_getBound();
+    RenderbufferInfo cb;
+    if (!getReadColorBuffer(ctx, &cb))
         return;
-    }
 
-    // The texture must have been previously allocated.
-    if (!tex->width || !tex->height || nativeFormat != tex->format) {
+    // Luminance and alpha formats can't be produced by the GX engine.
+    GPUTexFormat nativeFormat;
+    if (!tryUnwrapCopyFormat(internalformat, cb.format, &nativeFormat) || !checkCopyRect(&cb, x, y, width, height)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
 
-    GLASS_tex_writeUntiledRect(tex, data, face, level, xoffset, yoffset, width, height);
-*/
+    size_t face;
+    TextureInfo* tex = getTargetTexture(ctx, target, &face);
+    if (!tex)
+        return;
+
+    // Prepare memory.
+    if (GLASS_tex_realloc(tex, width << level, height << level, nativeFormat, tex->vram) == TEXREALLOCSTATUS_FAILED)
+        return;
+
+    GLASS_tex_copyColorBuffer(tex, face, level, 0, 0, &cb, x, y, width, height);
+    ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
 }
 
-void glTexVRAMPICA(GLboolean enabled) {
+void glCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (level < 0 || level >= GLASS_NUM_TEX_LEVELS) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
+    if (xoffset < 0 || yoffset < 0 || width < 0 || height < 0) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
+
     CtxCommon* ctx = GLASS_context_getBound();
-    TextureInfo* tex = (TextureInfo*)ctx->textureUnits[ctx->activeTextureUnit];
+    size_t face;
+    TextureInfo* tex = getTargetTexture(ctx, target, &face);
+    if (!tex)
+        return;
 
-    if (!tex) {
+    // The texture must have been previously allocated.
+    if (!tex->faces[face]) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
 
-    const TexReallocStatus reallocStatus = GLASS_tex_realloc(tex, tex->width, tex->height, tex->format, enabled);
-    KYGX_ASSERT(reallocStatus != TEXREALLOCSTATUS_FAILED);
+    // Check bounds.
+    if ((xoffset + width) > (tex->width >> level) || (yoffset + height) > (tex->height >> level)) {
+        GLASS_context_setError(GL_INVALID_VALUE);
+        return;
+    }
 
-    if (reallocStatus == TEXREALLOCSTATUS_UPDATED) {
-        tex->vram = enabled;
-        ctx->flags |= GLASS_CONTEXT_FLAG_TEXTURE;
+    RenderbufferInfo cb;
+    if (!getReadColorBuffer(ctx, &cb))
+        return;
+
+    // Alpha can't be made up.
+    const bool hasAlpha = (tex->format == TEXFORMAT_RGBA8) || (tex->format == TEXFORMAT_RGBA4) || (tex->format == TEXFORMAT_RGB5A1);
+    const bool isColor = hasAlpha || (tex->format == TEXFORMAT_RGB8) || (tex->format == TEXFORMAT_RGB565);
+    if (!isColor || (hasAlpha && (cb.format == GL_RGB565))) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
     }
-}
 
-void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid* data) {
-    // TODO
-    GLASS_context_setError(GL_INVALID_ENUM);
-}
+    if (!kygxIsAligned(xoffset, 8) || !kygxIsAligned(yoffset, 8) || !checkCopyRect(&cb, x, y, width, height)) {
+        GLASS_context_setError(GL_INVALID_OPERATION);
+        return;
+    }
 
-void glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid* data) {
-    // TODO
-    GLASS_context_setError(GL_INVALID_ENUM);    
+    if (width && height)
+        GLASS_tex_copyColorBuffer(tex, face, level, xoffset, yoffset, &cb, x, y, width, height);
 }
 
-// TODO
-void glCopyTexImage2D(GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border);
-void glCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height);
+static void releaseLinear(GLvoid* data, GLsizeiptr size) {
+    (void)size;
+    glassLinearFree(data);
+}
 
 static inline GPUTexFormat getNativeFormat(RIPPixelFormat pixelFormat) {
     switch (pixelFormat) {
@@ -701,8 +1098,8 @@ void glassMoveTex3DS(RIPTex3DS* tex3ds) {
         return;
     }
 
-    // Check if texture data has been moved already.
-    if (!tex3ds->faces[0]) {
+    // Check if texture data has been moved already. Transient storage can't hold it.
+    if (!tex3ds->faces[0] || tex->transient) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
     }
@@ -718,15 +1115,17 @@ void glassMoveTex3DS(RIPTex3DS* tex3ds) {
         const size_t numFaces = tex3ds->isCubeMap ? 6 : 1;
 
         for (size_t face = 0; face < numFaces; ++face) {
-            for (size_t level = 0; level < tex3ds->levels; ++level) {
-                const size_t mipmapOffset = ripGetTextureDataOffset(tex3ds->width, tex3ds->height, tex3ds->pixelFormat, level);
-                GLASS_tex_write(tex, tex3ds->faces[face] + mipmapOffset, face, level);
-            }
+            GLASS_tex_writeLevels(tex, tex3ds->faces[face], face, tex3ds->levels);
 
-            glassLinearFree(tex3ds->faces[face]);
+            // Free the source once the copies are done.
+            GLASS_bufferPool_releaseExternal(ctx, tex3ds->faces[face], glassLinearSize(tex3ds->faces[face]), tex->uploadFence, releaseLinear);
         }
     } else {
         // Just move the pointers.
+        const size_t numFaces = tex3ds->isCubeMap ? 6 : 1;
+        for (size_t face = 0; face < numFaces; ++face)
+            GLASS_context_markDirty(ctx, tex3ds->faces[face], glassLinearSize(tex3ds->faces[face]));
+
         GLASS_tex_setParams(tex, tex3ds->width, tex3ds->height, nativeFormat, false, tex3ds->faces);
     }
 
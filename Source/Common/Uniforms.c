@@ -49,11 +49,13 @@ static UniformInfo* getShaderUniform(const ProgramInfo* program, size_t index, b
     return &shader->activeUniforms[index];
 }
 
-void glGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+void glGetActiveUniform(GLuint programName, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
     KYGX_ASSERT(size);
     KYGX_ASSERT(type);
     KYGX_ASSERT(name);
 
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -143,9 +145,11 @@ static inline void getFloatUniform(const UniformInfo* info, size_t offset, u32*
     memcpy(out, &info->data.values[3 * offset], 3 * sizeof(u32));
 }
 
-static void getUniformValues(GLuint program, GLint location, GLint* intParams, GLfloat* floatParams) {
+static void getUniformValues(GLuint programName, GLint location, GLint* intParams, GLfloat* floatParams) {
     KYGX_ASSERT(intParams || floatParams);
 
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return;
@@ -280,7 +284,9 @@ static GLint lookupUniform(const ShaderInfo* shader, const char* name, size_t of
     return -1;
 }
 
-GLint glGetUniformLocation(GLuint program, const GLchar* name) {
+GLint glGetUniformLocation(GLuint programName, const GLchar* name) {
+    const GLuint program = GLASS_getObject(programName, GLASS_PROGRAM_TYPE);
+
     if (!GLASS_OBJ_IS_PROGRAM(program)) {
         GLASS_context_setError(GL_INVALID_OPERATION);
         return -1;
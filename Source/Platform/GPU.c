@@ -9,6 +9,7 @@
 
 #include "Platform/GPU.h"
 #include "Base/Math.h"
+#include "Base/MemStats.h"
 #include "Base/TexManager.h"
 
 #include <string.h> // memcpy, memset
@@ -125,11 +126,17 @@ void GLASS_gpu_allocList(GLASSGPUCommandList* list) {
     }
 
     KYGX_ASSERT(glassIsLinear(list->secondBuffer));
+
+    // Buffers are freed by GLASS, even if provided by the application.
+    GLASS_memStats_add(GLASS_MEMORY_COMMAND_LISTS, list->mainBuffer, list->capacity, GLASS_INVALID_OBJECT);
+    GLASS_memStats_add(GLASS_MEMORY_COMMAND_LISTS, list->secondBuffer, list->capacity, GLASS_INVALID_OBJECT);
 }
 
 void GLASS_gpu_freeList(GLASSGPUCommandList* list) {
     KYGX_ASSERT(list);
 
+    GLASS_memStats_remove(GLASS_MEMORY_COMMAND_LISTS, list->secondBuffer, list->capacity);
+    GLASS_memStats_remove(GLASS_MEMORY_COMMAND_LISTS, list->mainBuffer, list->capacity);
     glassLinearFree(list->secondBuffer);
     glassLinearFree(list->mainBuffer);
     list->secondBuffer = NULL;
@@ -1211,8 +1218,9 @@ void GLASS_gpu_setTextureUnits(GLASSGPUCommandList* list, const GLuint* units) {
     u32 config = (1u << 12);
 
     for (size_t i = 0; i < GLASS_NUM_TEX_UNITS; ++i) {
+        // Purged textures have no data.
         const TextureInfo* tex = (TextureInfo*)units[i];
-        if (!tex)
+        if (!tex || !tex->faces[0])
             continue;
 
         // Enable unit.